@@ -22,20 +22,282 @@ SOFTWARE.
 
 */
 #include "json.hpp"
+#include "json_number.hpp"
+#include "json_scan.hpp"
+#include "json_utf8.hpp"
 
-#include <stack>
 #include <sstream>
 #include <cmath>
-#include <iomanip>
+#include <cstring>
+#include <utility>
+#include <cstdlib>
+#include <cerrno>
+#include <istream>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define XYZ_JSON_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
 
 namespace xyz {
   namespace json {
 
+    namespace detail {
+      Arena::Arena(std::size_t blockSize)
+        :blockSize(blockSize),current(0),block(nullptr),used(0),capacity(0) {}
+
+      Arena::~Arena() {
+        for(std::size_t i = 0; i < blocks.size(); ++i) {
+          ::operator delete(blocks[i].first);
+        }
+      }
+
+      void *Arena::allocateBlock(std::size_t size, std::size_t alignment) {
+        // Move on to the next block that is large enough, reusing blocks kept by reset().
+        std::size_t needed = size + alignment;
+        std::size_t next = block ? current + 1 : 0;
+        while(next < blocks.size() && blocks[next].second < needed) {
+          ++next;
+        }
+        if(next == blocks.size()) {
+          std::size_t blockCapacity = needed > blockSize ? needed : blockSize;
+          blocks.push_back(std::make_pair(static_cast<char *>(::operator new(blockCapacity)), blockCapacity));
+        }
+
+        current = next;
+        block = blocks[next].first;
+        capacity = blocks[next].second;
+        used = 0;
+        return allocate(size, alignment);
+      }
+
+      void Arena::reset() {
+        current = 0;
+        block = nullptr;
+        used = 0;
+        capacity = 0;
+      }
+
+      void MappedFile::open(const char *path) {
+        close();
+#if defined(XYZ_JSON_MMAP)
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0) {
+          throw std::system_error(errno, std::generic_category(), path);
+        }
+
+        struct stat info;
+        if(::fstat(fd, &info) != 0) {
+          int error = errno;
+          ::close(fd);
+          throw std::system_error(error, std::generic_category(), path);
+        }
+
+        // Empty files cannot be mapped, and need no memory anyway.
+        if(info.st_size > 0) {
+          void *address = ::mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+          if(address == MAP_FAILED) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), path);
+          }
+          data = static_cast<const char *>(address);
+          size = std::size_t(info.st_size);
+          mapped = true;
+        }
+        ::close(fd);
+#else
+        std::ifstream stream(path, std::ios::binary);
+        if(!stream) {
+          throw std::system_error(errno, std::generic_category(), path);
+        }
+        std::vector<char> contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+        if(stream.bad()) {
+          throw std::system_error(errno, std::generic_category(), path);
+        }
+        if(!contents.empty()) {
+          char *buffer = new char[contents.size()];
+          std::memcpy(buffer, contents.data(), contents.size());
+          data = buffer;
+          size = contents.size();
+        }
+#endif
+      }
+
+      void MappedFile::close() {
+        if(data) {
+#if defined(XYZ_JSON_MMAP)
+          if(mapped) {
+            ::munmap(const_cast<char *>(data), size);
+          }
+#else
+          delete[] data;
+#endif
+        }
+        data = nullptr;
+        size = 0;
+        mapped = false;
+      }
+    }
+
+    namespace detail {
+      template<typename T>
+      Box<T> *shareBox(Box<T> *box, bool inArena) {
+        // Share the box with a copy of its element, or copy the value to the heap if it cannot be shared.
+        if(!inArena && box->shareable) {
+          box->references.fetch_add(1, std::memory_order_relaxed);
+          return box;
+        }
+        return new Box<T>(box->value);
+      }
+
+      template<typename T>
+      void releaseBox(Box<T> *box, bool inArena) {
+        if(inArena) {
+          box->~Box<T>();
+          return;
+        }
+        // The only owner can skip the atomic decrement, no one else can take a reference.
+        if(box->references.load(std::memory_order_acquire) == 1 ||
+           box->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          delete box;
+        }
+      }
+
+      template<typename T>
+      T &ownBox(Box<T> *&box) {
+        // Copy a shared value, so it can be changed without affecting other elements.
+        if(box->references.load(std::memory_order_acquire) != 1) {
+          Box<T> *copy = new Box<T>(box->value);
+          releaseBox(box, false);
+          box = copy;
+        }
+        return box->value;
+      }
+
+      template<typename T>
+      void *allocateBox(const Allocator<char> &allocator) {
+        return allocator.arena->allocate(sizeof(Box<T>), alignof(Box<T>));
+      }
+    }
+
+    void Document::clear() {
+      tree = Element();
+      arena.reset();
+    }
+
+    Element::Element(Type type):type(type),numberType(FLOATING_POINT),inArena(false) {
+      switch(type) {
+        case OBJECT: _object = new detail::Box<Object>(); break;
+        case ARRAY: _array = new detail::Box<Array>(); break;
+        case STRING: _string = new detail::Box<String>(); break;
+        case NUMBER: _number = 0; break;
+        case BOOLEAN: _boolean = false; break;
+        default: break;
+      }
+    }
+
+    Element::Element(const Object &object):type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) {
+      _object = new detail::Box<Object>(object);
+      type = OBJECT;
+    }
+
+    Element::Element(Object &&object):type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) {
+      _object = new detail::Box<Object>(std::move(object));
+      type = OBJECT;
+    }
+
+    Element::Element(const Array &array):type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) {
+      _array = new detail::Box<Array>(array);
+      type = ARRAY;
+    }
+
+    Element::Element(Array &&array):type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) {
+      _array = new detail::Box<Array>(std::move(array));
+      type = ARRAY;
+    }
+
+    Element::Element(const String &str):type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) {
+      _string = new detail::Box<String>(str);
+      type = STRING;
+    }
+
+    Element::Element(String &&str):type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) {
+      _string = new detail::Box<String>(std::move(str));
+      type = STRING;
+    }
+
+    Element::Element(const char *str):type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) {
+      _string = new detail::Box<String>(str);
+      type = STRING;
+    }
+
+    Element::Element(Type type, const Allocator<char> &allocator)
+      :type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false)
+    {
+      if(!allocator.arena || type == NULL_VALUE || type == NUMBER || type == BOOLEAN) {
+        Element(type).swap(*this);
+        return;
+      }
+
+      switch(type) {
+        case OBJECT:
+          _object = new(detail::allocateBox<Object>(allocator)) detail::Box<Object>(allocator);
+          break;
+        case ARRAY:
+          _array = new(detail::allocateBox<Array>(allocator)) detail::Box<Array>(allocator);
+          break;
+        default:
+          _string = new(detail::allocateBox<String>(allocator)) detail::Box<String>();
+          break;
+      }
+      this->type = type;
+      inArena = true;
+    }
+
+    Element::Element(String &&str, const Allocator<char> &allocator)
+      :type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false)
+    {
+      if(!allocator.arena) {
+        _string = new detail::Box<String>(std::move(str));
+      }
+      else {
+        _string = new(detail::allocateBox<String>(allocator)) detail::Box<String>(std::move(str));
+        inArena = true;
+      }
+      type = STRING;
+    }
+
+    void Element::release() {
+      switch(type) {
+        case OBJECT: detail::releaseBox(_object, inArena); break;
+        case ARRAY: detail::releaseBox(_array, inArena); break;
+        case STRING: detail::releaseBox(_string, inArena); break;
+        default: break;
+      }
+    }
+
     Element::Type Element::getType() const {
       return type;
     }
 
-    const char *Element::getTypeName() const {
+    const char *typeName(Element::Type type) {
       if(type < 0 || type > 5) {
         throw TypeError("TypeError: Invalid type.");
       }
@@ -43,23 +305,50 @@ namespace xyz {
       return names[type];
     }
 
+    const char *Element::getTypeName() const {
+      return typeName(type);
+    }
+
     Object &Element::object() {
       if(type != OBJECT) throw TypeError(OBJECT);
-      return _object;
+      Object &object = detail::ownBox(_object);
+      _object->shareable = false;
+      return object;
     }
 
     Array &Element::array() {
       if(type != ARRAY) throw TypeError(ARRAY);
-      return _array;
+      Array &array = detail::ownBox(_array);
+      _array->shareable = false;
+      return array;
     }
 
     String &Element::str() {
       if(type != STRING) throw TypeError(STRING);
-      return _string;
+      String &str = detail::ownBox(_string);
+      _string->shareable = false;
+      return str;
+    }
+
+    void Element::set(const Key &key, Element &&value) {
+      if(type != OBJECT) throw TypeError(OBJECT);
+      detail::ownBox(_object)[key] = std::move(value);
+    }
+
+    void Element::append(Element &&value) {
+      if(type != ARRAY) throw TypeError(ARRAY);
+      detail::ownBox(_array).push_back(std::move(value));
     }
 
     Number &Element::number() {
       if(type != NUMBER) throw TypeError(NUMBER);
+      if(numberType == SIGNED_INTEGER) {
+        _number = Number(_integer);
+      }
+      else if(numberType == UNSIGNED_INTEGER) {
+        _number = Number(_unsignedInteger);
+      }
+      numberType = FLOATING_POINT;
       return _number;
     }
 
@@ -70,22 +359,61 @@ namespace xyz {
 
     const Object &Element::object() const {
       if(type != OBJECT) throw TypeError(OBJECT);
-      return _object;
+      return _object->value;
     }
 
     const Array &Element::array() const {
       if(type != ARRAY) throw TypeError(ARRAY);
-      return _array;
+      return _array->value;
     }
 
     const String &Element::str() const {
       if(type != STRING) throw TypeError(STRING);
-      return _string;
+      return _string->value;
     }
 
-    const Number &Element::number() const {
+    Number Element::number() const {
       if(type != NUMBER) throw TypeError(NUMBER);
-      return _number;
+      switch(numberType) {
+        case SIGNED_INTEGER: return Number(_integer);
+        case UNSIGNED_INTEGER: return Number(_unsignedInteger);
+        default: return _number;
+      }
+    }
+
+    Element::NumberType Element::getNumberType() const {
+      if(type != NUMBER) throw TypeError(NUMBER);
+      return numberType;
+    }
+
+    Integer Element::integer() const {
+      if(type != NUMBER) throw TypeError(NUMBER);
+      switch(numberType) {
+        case SIGNED_INTEGER:
+          return _integer;
+        case UNSIGNED_INTEGER:
+          if(_unsignedInteger > UnsignedInteger(std::numeric_limits<Integer>::max())) break;
+          return Integer(_unsignedInteger);
+        default:
+          if(!(_number >= -9223372036854775808.0 && _number < 9223372036854775808.0)) break;
+          return Integer(_number);
+      }
+      throw TypeError("TypeError: Number out of range.");
+    }
+
+    UnsignedInteger Element::unsignedInteger() const {
+      if(type != NUMBER) throw TypeError(NUMBER);
+      switch(numberType) {
+        case SIGNED_INTEGER:
+          if(_integer < 0) break;
+          return UnsignedInteger(_integer);
+        case UNSIGNED_INTEGER:
+          return _unsignedInteger;
+        default:
+          if(!(_number > -1.0 && _number < 18446744073709551616.0)) break;
+          return UnsignedInteger(_number);
+      }
+      throw TypeError("TypeError: Number out of range.");
     }
 
     const Boolean &Element::boolean() const {
@@ -93,14 +421,33 @@ namespace xyz {
       return _boolean;
     }
 
+    bool equalsInteger(Number value, Integer integer) {
+      // Compare exactly, rather than after rounding the integer to a double.
+      return value >= -9223372036854775808.0 && value < 9223372036854775808.0 &&
+             Integer(value) == integer && Number(Integer(value)) == value;
+    }
+
+    bool equalsInteger(Number value, UnsignedInteger integer) {
+      return value >= 0 && value < 18446744073709551616.0 &&
+             UnsignedInteger(value) == integer && Number(UnsignedInteger(value)) == value;
+    }
+
+    std::size_t formatNumber(const Element &number, char *buffer) {
+      // Write a finite number to a buffer of detail::NUMBER_BUFFER_SIZE characters.
+      switch(number.getNumberType()) {
+        case Element::SIGNED_INTEGER: return detail::formatInteger(number.integer(), buffer);
+        case Element::UNSIGNED_INTEGER: return detail::formatInteger(number.unsignedInteger(), buffer);
+        default: return detail::formatNumber(number.number(), buffer);
+      }
+    }
+
     String Element::toString() const {
       if(isString()) {
         return '"' + str() + '"';
       }
       if(isNumber()) {
-        std::ostringstream os;
-        os << number();
-        return os.str();
+        char buffer[detail::NUMBER_BUFFER_SIZE];
+        return String(buffer, formatNumber(*this, buffer));
       }
       if(isNull()) {
         return "null";
@@ -127,42 +474,40 @@ namespace xyz {
         return *this;
       }
 
+      // Copy before releasing, in case r is a child of this element. Containers and strings are shared
+      // with r where possible, so this is constant time.
+      Element tmp(NULL_VALUE);
       if(r.type == OBJECT) {
-        if(type == OBJECT) {
-          // In case r is child of _object.
-          Object tmp(r._object);
-          _object.swap(tmp);
-        } else {
-          _object = r._object;
-        }
-        _array.clear();
-        _string.clear();
+        tmp._object = detail::shareBox(r._object, r.inArena);
       }
       else if(r.type == ARRAY) {
-        if(type == ARRAY) {
-          // In case r is child of _array.
-          Array tmp(r._array);
-          _array.swap(tmp);
-        } else {
-          _array = r._array;
-        }
-        _object.clear();
-        _string.clear();
-      }
-      else if(r.type != NULL_VALUE) {
-	_string = r._string;
-	_number = r._number;
-	_boolean = r._boolean;
-        _object.clear();
-        _array.clear();
+        tmp._array = detail::shareBox(r._array, r.inArena);
       }
-      else {
-        _object.clear();
-        _array.clear();
-        _string.clear();
+      else if(r.type == STRING) {
+        tmp._string = detail::shareBox(r._string, r.inArena);
+      }
+      else if(r.type == NUMBER) {
+        tmp._number = r._number;
+        tmp.numberType = r.numberType;
+      }
+      else if(r.type == BOOLEAN) {
+        tmp._boolean = r._boolean;
       }
+      tmp.type = r.type;
 
-      type = r.type;
+      swap(tmp);
+
+      return *this;
+    }
+
+    Element &Element::operator =(Element &&r) noexcept {
+      if(this == &r) {
+        return *this;
+      }
+
+      // Take r first, in case it is a child of this element.
+      Element tmp(std::move(r));
+      swap(tmp);
 
       return *this;
     }
@@ -175,13 +520,26 @@ namespace xyz {
         return true;
       }
       if(type == OBJECT) {
-	return object() == r.object();
+	return _object == r._object || object() == r.object();
       }
       if(type == ARRAY) {
-	return array() == r.array();
+	return _array == r._array || array() == r.array();
       }
       if(type == NUMBER) {
-	return _number == r._number;
+        if(numberType == FLOATING_POINT && r.numberType == FLOATING_POINT) {
+          return _number == r._number;
+        }
+        if(numberType == FLOATING_POINT) {
+          return r == *this;
+        }
+        if(r.numberType == FLOATING_POINT) {
+          return numberType == SIGNED_INTEGER ? equalsInteger(r._number, _integer) : equalsInteger(r._number, _unsignedInteger);
+        }
+        // Integers of different signedness only match if neither is negative.
+        if(numberType != r.numberType && (numberType == SIGNED_INTEGER ? _integer : r._integer) < 0) {
+          return false;
+        }
+        return _unsignedInteger == r._unsignedInteger;
       }
       if(type == BOOLEAN) {
         return _boolean == r._boolean;
@@ -189,480 +547,2987 @@ namespace xyz {
       return str() == r.str();
     }
 
-    void Element::swap(Element &r) {
+    void Element::swap(Element &r) noexcept {
       if(this == &r) {
         return;
       }
 
-      if(r.type == OBJECT || type == OBJECT) {
-	_object.swap(r._object);
-      }
-
-      if(r.type == ARRAY || type == ARRAY) {
-	_array.swap(r._array);
-      }
-
-      if(r.type == STRING || type == STRING) {
-	_string.swap(r._string);
-      }
-
-      bool b = _boolean;
-      _boolean = r._boolean;
-      r._boolean = b;
-
-      Number n = _number;
-      _number = r._number;
-      r._number = n;
+      // All union members share the storage of _number, which is the widest of them.
+      static_assert(sizeof(Number) >= sizeof(Object *), "Payload must fit in a Number.");
+      char payload[sizeof(Number)];
+      std::memcpy(payload, &_number, sizeof(payload));
+      std::memcpy(&_number, &r._number, sizeof(payload));
+      std::memcpy(&r._number, payload, sizeof(payload));
 
       Type t = type;
       type = r.type;
       r.type = t;
+
+      NumberType n = numberType;
+      numberType = r.numberType;
+      r.numberType = n;
+
+      bool a = inArena;
+      inArena = r.inArena;
+      r.inArena = a;
     }
 
-    String::value_type parseHexChar(std::istream &stream, int &line) {
-      String buf = "    ";
-      if(!stream.read(&(buf[0]), 4)) {
-        throw SyntaxError("Unexpected end of file while reading character escape sequence.", line, buf[0]);
+    namespace detail {
+      std::size_t hashKey(const char *data, std::size_t size) {
+        // FNV-1a, which is quick for the short strings typical of keys.
+        std::uint64_t hash = 14695981039346656037ull;
+        for(std::size_t i = 0; i < size; ++i) {
+          hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+        }
+        return std::size_t(hash);
       }
 
-      std::size_t pos = 0;
-      int val = -1;
-
-      try {
-        val = std::stoi(buf, &pos, 16);
-      } catch(std::invalid_argument &e) {
-      } catch(std::out_of_range &e) {
+      const String &emptyKey() {
+        static const String empty;
+        return empty;
       }
+    }
+
+    Key::Key(const String &text)
+      :node(new detail::KeyNode(String(text), detail::hashKey(text.data(), text.size()), false)) {}
+
+    Key::Key(String &&text)
+      :node(nullptr)
+    {
+      std::size_t hash = detail::hashKey(text.data(), text.size());
+      node = new detail::KeyNode(std::move(text), hash, false);
+    }
 
-      if(val < 0 || pos != 4) {
-        throw SyntaxError("Invalid character escape sequence.", line, buf[0]);
+    Key::Key(const char *text)
+      :node(new detail::KeyNode(String(text), detail::hashKey(text, std::strlen(text)), false)) {}
+
+    Key Key::intern(const char *name) {
+      // Names are usually literals, so a per thread cache looks them up by address without locking.
+      // The text is still compared, in case the address is reused for another name.
+      thread_local std::pair<const char *, detail::KeyNode *> cache[64];
+      std::pair<const char *, detail::KeyNode *> &cached = cache[(reinterpret_cast<std::uintptr_t>(name) >> 3) & 63];
+      if(cached.first == name && cached.second->text == name) {
+        return Key(cached.second);
       }
 
-      if(val > 0xff) {
-        throw SyntaxError("Escape sequence above Latin-1 not implemented.", line, buf[0]);
+      // The table is never destroyed, so keys stay valid during static destruction.
+      static std::mutex *mutex = new std::mutex();
+      static std::unordered_map<String, detail::KeyNode *> *table = new std::unordered_map<String, detail::KeyNode *>();
+
+      std::lock_guard<std::mutex> lock(*mutex);
+      detail::KeyNode *&node = (*table)[name];
+      if(!node) {
+        String text(name);
+        std::size_t hash = detail::hashKey(text.data(), text.size());
+        node = new detail::KeyNode(std::move(text), hash, true);
       }
+      cached = std::make_pair(name, node);
+      return Key(node);
+    }
 
-      return String::value_type(val);
+    void Object::clear() {
+      entries.clear();
+      index.clear();
     }
 
-    void parseString(std::istream &stream, String &str, int &line) {
-      // Read string content up to and including terminating quote.
-      // Opening quote must have been previously consumed from stream.
-
-      std::ostringstream os;
-      char in;
-      bool escaped = false;
-
-      while(stream.read(&in, 1)) {
-        if(escaped) {
-          if(in == '\\') os << '\\';
-          else if(in == '"') os << '"';
-          else if(in == 'n') os << '\n';
-          else if(in == 'r') os << '\r';
-          else if(in == 't') os << '\t';
-          else if(in == 'f') os << '\f';
-          else if(in == 'b') os << '\b';
-          else if(in == '/') os << '/';
-          else if(in == 'u') {
-            os << parseHexChar(stream, line);
-          }
-          else {
-            throw SyntaxError("Illegal string escape sequence", line, in);
+    Object::const_iterator Object::find(const char *data, std::size_t size, std::size_t hash) const {
+      if(index.empty()) {
+        for(const_iterator it = entries.begin(); it != entries.end(); ++it) {
+          if(it->first.equals(data, size, hash)) {
+            return it;
           }
-          escaped = false;
         }
-        else {
-          if(in == '"') {
-            str = os.str();
-            return;
-          }
-          if(in == '\\') {
-            escaped = true;
-          }
-          else if((in >= '\x00' && in <= '\x1f') || in == '\x7f' || (in >= '\x80' && in <= '\x9f')) {
-            throw SyntaxError("Control character in string.", line, in);
-          }
-          else {
-            os << in;
-          }
+        return entries.end();
+      }
+
+      std::size_t mask = index.size() - 1;
+      for(std::size_t slot = hash & mask; index[slot]; slot = (slot + 1) & mask) {
+        const_iterator it = entries.begin() + (index[slot] - 1);
+        if(it->first.equals(data, size, hash)) {
+          return it;
         }
       }
+      return entries.end();
+    }
 
-      throw SyntaxError("Unexpected end of file while parsing string.", line, in);
+    Object::const_iterator Object::find(const Key &key) const {
+      return find(key.str().data(), key.size(), key.hash());
     }
 
-    char parseNumber(std::istream &stream, char first, Number &num, int &line) {
-      // Read number from stream.
-      // This function is more permissive than the json standard, e.g. allowing leading '+'.
-      // The first character must have been consumed from stream and passed as "first".
-      // This function may consume a character past the end of the number,
-      // in which case it is returned, otherwise ' ' is returned.
+    Object::const_iterator Object::find(const String &key) const {
+      return find(key.data(), key.size(), detail::hashKey(key.data(), key.size()));
+    }
 
-      std::ostringstream os;
-      os << first;
+    Object::const_iterator Object::find(const char *key) const {
+      std::size_t size = std::strlen(key);
+      return find(key, size, detail::hashKey(key, size));
+    }
 
-      char in;
-      char extra = ' ';
+    Object::iterator Object::find(const Key &key) {
+      return entries.begin() + (static_cast<const Object &>(*this).find(key) - entries.begin());
+    }
 
-      while(stream.read(&in, 1)) {
-        if((in < '0' || in > '9') && in != '-' && in != '+' && in != '.' && in != 'e' && in != 'E') {
-          extra = in;
-          break;
-        }
-        os << in;
-      }
+    Object::iterator Object::find(const String &key) {
+      return entries.begin() + (static_cast<const Object &>(*this).find(key) - entries.begin());
+    }
 
-      try {
-        std::size_t read;
-        num = std::stod(os.str(), &read);
-        if(read != os.str().length()) {
-          throw SyntaxError("Illegal number format.", line, first);
-        }
-      } catch(std::invalid_argument &e) {
-        throw SyntaxError("Failed to parse number", line, first);
-      } catch(std::out_of_range &e) {
-        throw SyntaxError("Failed to parse number, value out of range", line, first);
-      }
+    Object::iterator Object::find(const char *key) {
+      return entries.begin() + (static_cast<const Object &>(*this).find(key) - entries.begin());
+    }
+
+    Element &Object::at(const String &key) {
+      iterator it = find(key);
+      if(it == entries.end()) throw std::out_of_range("Object::at");
+      return it->second;
+    }
 
-      return extra;
+    const Element &Object::at(const String &key) const {
+      const_iterator it = find(key);
+      if(it == entries.end()) throw std::out_of_range("Object::at");
+      return it->second;
     }
 
-    void parseNull(std::istream &stream, int &line) {
-      // Read and verify the primitive "null".
-      // The first character must have been consumed and verified to be 'n'.
-      String v = "n   ";
-      if(!stream.read(&v[1], 3) || v != "null") {
-        throw SyntaxError("Expected \"null\"", line, v[1]);
+    Element &Object::operator [](const Key &key) {
+      iterator it = find(key);
+      if(it != entries.end()) {
+        return it->second;
       }
+      return append(value_type(key, Element()))->second;
     }
 
-    void parseFalse(std::istream &stream, int &line) {
-      // Read and verify the primitive "false".
-      // The first character must have been consumed and verified to be 'f'.
-      String v = "f    ";
-      if(!stream.read(&v[1], 4) || v != "false") {
-        throw SyntaxError("Expected \"false\"", line, v[1]);
+    Element &Object::operator [](Key &&key) {
+      iterator it = find(key);
+      if(it != entries.end()) {
+        return it->second;
       }
+      return append(value_type(std::move(key), Element()))->second;
     }
 
-    void parseTrue(std::istream &stream, int &line) {
-      // Read and verify the primitive "true".
-      // The first character must have been consumed and verified to be 't'.
-      String v = "t   ";
-      if(!stream.read(&v[1], 3) || v != "true") {
-        throw SyntaxError("Expected \"true\"", line, v[1]);
+    Element &Object::operator [](const String &key) {
+      iterator it = find(key);
+      if(it != entries.end()) {
+        return it->second;
       }
+      return append(value_type(Key(key), Element()))->second;
     }
 
-    char parsePrimitive(std::istream &stream, char first, Element &el, int &line) {
-      // Read a primitive from stream (null, bool, number, string, not array or object).
-      // The first character must have been consumed from stream and passed as "first".
-      // This function may consume a character past the end of the primitive,
-      // in which case it is returned, otherwise ' ' is returned.
+    Element &Object::operator [](const char *key) {
+      iterator it = find(key);
+      if(it != entries.end()) {
+        return it->second;
+      }
+      return append(value_type(Key(key), Element()))->second;
+    }
 
-      if(first == 'n') {
-        parseNull(stream, line);
-        el = Element(Element::NULL_VALUE);
+    std::pair<Object::iterator, bool> Object::insert(const value_type &entry) {
+      iterator it = find(entry.first);
+      if(it != entries.end()) {
+        return std::make_pair(it, false);
       }
-      else if(first == 't') {
-        parseTrue(stream, line);
-        el = Element(true);
+      return std::make_pair(append(value_type(entry)), true);
+    }
+
+    std::pair<Object::iterator, bool> Object::insert(value_type &&entry) {
+      iterator it = find(entry.first);
+      if(it != entries.end()) {
+        return std::make_pair(it, false);
       }
-      else if(first == 'f') {
-        parseFalse(stream, line);
-        el = Element(false);
+      return std::make_pair(append(std::move(entry)), true);
+    }
+
+    Object::size_type Object::erase(const String &key) {
+      const_iterator it = find(key);
+      if(it == entries.end()) {
+        return 0;
       }
-      else if(first == '"') {
-        el = Element(Element::STRING);
-        parseString(stream, el.str(), line);
+      erase(it);
+      return 1;
+    }
+
+    Object::iterator Object::erase(const_iterator pos) {
+      // Positions after pos change, so the index is rebuilt.
+      std::size_t position = std::size_t(pos - entries.begin());
+      entries.erase(entries.begin() + position);
+      buildIndex();
+      return entries.begin() + position;
+    }
+
+    void Object::swap(Object &r) noexcept {
+      entries.swap(r.entries);
+      index.swap(r.index);
+    }
+
+    bool Object::operator ==(const Object &r) const {
+      if(entries.size() != r.entries.size()) {
+        return false;
       }
-      else if(first == '-' || (first >= '0' && first <= '9')) {
-        el = Element(Element::NUMBER);
-        return parseNumber(stream, first, el.number(), line);
+      for(std::size_t position = 0; position < entries.size(); ++position) {
+        // Entries are usually in the same order, so try the same position first.
+        const value_type &entry = entries[position];
+        const_iterator other = r.entries[position].first == entry.first ? r.entries.begin() + position : r.find(entry.first);
+        if(other == r.entries.end() || !(other->second == entry.second)) {
+          return false;
+        }
       }
-      else {
-        throw SyntaxError("Primitive must be one of null, true, false, number or quoted string.", line, first);
+      return true;
+    }
+
+    Object::iterator Object::append(value_type &&entry) {
+      entries.push_back(std::move(entry));
+      if(entries.size() >= INDEX_THRESHOLD) {
+        addToIndex(entries.size() - 1);
+      }
+      return entries.end() - 1;
+    }
+
+    void Object::addToIndex(std::size_t position) {
+      // Keep the table at most half full, so probe sequences stay short.
+      if(entries.size() * 2 > index.size()) {
+        buildIndex();
+        return;
       }
 
-      return ' ';
+      std::size_t mask = index.size() - 1;
+      std::size_t slot = entries[position].first.hash() & mask;
+      while(index[slot]) {
+        slot = (slot + 1) & mask;
+      }
+      index[slot] = std::uint32_t(position + 1);
     }
 
-    void skipLineComment(std::istream &stream, int &line) {
-      char in;
-      if(!stream.read(&in, 1) || in != '/') {
-        throw SyntaxError("Expected second '/' to begin line comment.", line, in);
+    void Object::buildIndex() {
+      if(entries.size() < INDEX_THRESHOLD) {
+        std::vector<std::uint32_t, Allocator<std::uint32_t>>(index.get_allocator()).swap(index);
+        return;
+      }
+
+      std::size_t size = 2 * INDEX_THRESHOLD;
+      while(size < entries.size() * 4) {
+        size *= 2;
       }
+      index.assign(size, 0);
 
-      while(stream.read(&in, 1)) {
-        if(in == '\n' || in == '\r') {
-          ++line;
-          break;
+      std::size_t mask = size - 1;
+      for(std::size_t position = 0; position < entries.size(); ++position) {
+        std::size_t slot = entries[position].first.hash() & mask;
+        while(index[slot]) {
+          slot = (slot + 1) & mask;
         }
+        index[slot] = std::uint32_t(position + 1);
       }
     }
 
-    std::istream &deserialize(std::istream &stream, Element &root)
-    {
-      enum State {
-          S_PRE_ELEMENT,   // Read an element (root, array item or object value) or close parent array.
-          S_PRE_KEY,       // Inside object, read quoted key name or close object.
-          S_PRE_SEP,       // Inside object (after key), read ':' before value.
-          S_POST_ELEMENT,  // After complete element (key+value if parent is obj). Read comma, close parent array/object or finish.
-      };
-
-      State state = S_PRE_ELEMENT;
+    struct StringProgress {
+      // How far a string cut off by the end of a partial buffer has been read. Once the buffer has been
+      // extended, reading goes on from there instead of from the opening quote, so that a string spanning
+      // many buffers is still read only once.
+      StringProgress() {
+        clear();
+      }
 
-      // Parents of any element in the stack must not be modified as a reallocation would be very bad.
-      std::stack<Element*> nodes;
-      nodes.push(&root);
-      root = Element::NULL_VALUE;
+      void clear() {
+        quote = -1;
+        cut = false;
+      }
 
-      // S_PRE_KEY sets this variable to pass the key (for the following value) to S_PRE_ELEMENT.
-      String key;
+      void save(std::ptrdiff_t at, std::size_t unchecked, std::size_t unread) {
+        // Called as the string with its opening quote at offset at from the start of the buffer is cut off.
+        quote = at;
+        run = unchecked;
+        scanned = unread;
+        cut = true;
+      }
 
-      int line = 1;
-      char in;
+      void rebase(std::ptrdiff_t token) {
+        // Called as the parser stops at the token at offset token, which the next buffer will start with.
+        // Anything saved before this buffer has been resumed or is stale.
+        quote = cut ? quote - token : -1;
+        cut = false;
+      }
 
-      while(stream.read(&in, 1)) {
-      redo:
-        if(in == '/') {
-          skipLineComment(stream, line);
-          continue;
+      bool resumes(std::ptrdiff_t at) {
+        // Whether the string with its opening quote at offset at is the one to resume. It is resumed once.
+        if(quote != at) {
+          return false;
         }
+        quote = -1;
+        return true;
+      }
 
-        // TODO: Respect system's endl for line numbering.
-        if(in == '\n' || in == '\r') {
-          ++line;
-        }
+      // Offset of the opening quote from the start of the buffer, or -1 if there is no string to resume.
+      std::ptrdiff_t quote;
 
-        if(in == ' ' || in == '\r' || in == '\n' || in == '\t') {
-          continue;
-        }
+      // Offsets from the opening quote of the characters not validated and kept yet, and of those not
+      // read yet. Escape sequences cut off are read again from their backslash.
+      std::size_t run;
+      std::size_t scanned;
 
-        switch(state) {
+      // Set while quote is relative to the buffer the string was cut off in.
+      bool cut;
+    };
 
-          case S_PRE_KEY: {
-            if(in == '"') {
-              parseString(stream, key, line);
-              state = S_PRE_SEP;
-            }
-            else if(in == '}') {
-              state = S_POST_ELEMENT;
-              goto redo;
-            }
-            else {
-              throw SyntaxError("Expected key or closing bracket.", line, in);
-            }
-          } break;
+    struct Cursor {
+      // Read position within a contiguous input buffer.
+      Cursor(const char *data, std::size_t size)
+        :begin(data),pos(data),end(data + size),index(nullptr),line(1),previous('\0'),partial(false),
+         progress(nullptr) {}
 
-          case S_PRE_SEP: {
-            if(in != ':') {
-              throw SyntaxError("Expected ':' separating key and value.", line, in);
-            }
-            state = S_PRE_ELEMENT;
-          } break;
+      const char *begin;
+      const char *pos;
+      const char *end;
 
-          case S_PRE_ELEMENT: {
+      // Optional stage-1 index used to skip whitespace, see json_scan.hpp.
+      detail::StructuralIndex *index;
 
-            if(nodes.top()->isNull()) {
-              // Root element.
-            }
-            else if(nodes.top()->isArray()) {
-              if(in == ']') {
-                state = S_POST_ELEMENT;
-                goto redo;
-              }
+      // Line number of begin and the character before it, for buffers which do not start at the
+      // beginning of the document.
+      int line;
+      char previous;
 
-              nodes.top()->array().push_back(Element());
-              nodes.push(&(nodes.top()->array().back()));
-            }
-            else if(nodes.top()->isObject()) {
-              nodes.top()->object()[key] = Element();
-              nodes.push(&(nodes.top()->object()[key]));
-            }
+      // Set if more input may follow end. A token running into end then throws Incomplete.
+      bool partial;
 
-            if(in == '[') {
-              *nodes.top() = Element(Element::ARRAY);
-              state = S_PRE_ELEMENT;
-            }
-            else if(in == '{') {
-              *nodes.top() = Element(Element::OBJECT);
-              state = S_PRE_KEY;
-            }
-            else {
-              *nodes.top() = Element(Element::NULL_VALUE);
-              in = parsePrimitive(stream, in, *nodes.top(), line);
-              nodes.pop();
-              state = S_POST_ELEMENT;
-              goto redo;
-            }
-          } break;
+      // Where strings cut off by end are recorded and resumed from, if anywhere.
+      StringProgress *progress;
+    };
 
-          case S_POST_ELEMENT: {
-            if(nodes.empty()) {
-              throw SyntaxError("Input after end.", line, in);
-            }
+    struct Incomplete {
+      // Thrown when a token is cut off by the end of a partial buffer.
+    };
 
-            if(in == ',') {
-              state = nodes.top()->isArray() ? S_PRE_ELEMENT : S_PRE_KEY;
-            }
-            else if(in == ']') {
-              if(!nodes.top()->isArray()) {
-                throw SyntaxError("Token ']' is illegal inside object.", line, in);
-              }
-              nodes.pop();
-              state = S_POST_ELEMENT;
-            }
-            else if(in == '}') {
-              if(!nodes.top()->isObject()) {
-                throw SyntaxError("Token '}' is illegal inside array.", line, in);
-              }
-              nodes.pop();
-              state = S_POST_ELEMENT;
-            }
-            else {
-                throw SyntaxError("Expected ',' or closing bracket.", line, in);
-            }
-          } break;
+    bool worthIndexing(std::size_t size) {
+      // Building a structural index only pays off once there is more than a few blocks of input.
+      return size >= 4096;
+    }
 
+    // Streams are read, and each block parsed as soon as it has arrived, this many bytes at a time.
+    const std::size_t STREAM_BLOCK_SIZE = 65536;
+
+    int countLineBreaks(const char *begin, const char *end) {
+      // TODO: Respect system's endl for line numbering.
+      int count = 0;
+      for(const char *it = begin; it < end; ++it) {
+        if(*it == '\n' || *it == '\r') {
+          ++count;
         }
       }
+      return count;
+    }
 
-      if(!(state == S_POST_ELEMENT && nodes.empty())) {
-        throw SyntaxError("Unexpected end of file.", line, in);
-      }
+    [[noreturn]] void throwSyntaxError(const Cursor &cursor, const char *msg, const char *at) {
+      // Line numbers are only needed on failure, so they are counted here rather than while parsing.
+      int line = cursor.line + countLineBreaks(cursor.begin, at < cursor.end ? at : cursor.end);
 
-      return stream;
+      char chr = '\0';
+      if(at < cursor.end) chr = *at;
+      else if(at > cursor.begin) chr = at[-1];
+      else chr = cursor.previous;
+
+      throw SyntaxError(msg, line, chr);
     }
 
-    Element deserialize(const String &str)
-    {
-      std::istringstream is(str);
-      Element el;
-      deserialize(is, el);
+    [[noreturn]] void throwEndOfInput(const Cursor &cursor, const char *msg, const char *at) {
+      // A token ran into the end of the buffer. That is only an error if no more input follows.
+      if(cursor.partial) {
+        throw Incomplete();
+      }
+      throwSyntaxError(cursor, msg, at);
+    }
 
-      return el;
+    int hexDigit(char in) {
+      if(in >= '0' && in <= '9') return in - '0';
+      if(in >= 'a' && in <= 'f') return in - 'a' + 10;
+      if(in >= 'A' && in <= 'F') return in - 'A' + 10;
+      return -1;
     }
 
-    void serializeString(std::ostream &stream, const Element &node) {
-      stream << '"';
-      const String &str = node.str();
-      for(String::const_iterator it = str.begin(); it != str.end(); ++it) {
-          if(*it == '\\') stream << "\\\\";
-          else if(*it == '"') stream << "\\\"";
-          else if(*it == '\n') stream << "\\n";
-          else if(*it == '\r') stream << "\\r";
-          else if(*it == '\t') stream << "\\t";
-          else if(*it == '\f') stream << "\\f";
-          else if(*it == '\b') stream << "\\b";
-          else if((*it >= '\x00' && *it <= '\x1f') ||
-                  (*it == '\x7f') ||
-                  (*it >= '\x80' && *it <= '\x9f') ||
-                  (*it >= '\x80' && *it <= '\xff')) {
-            // Print control and extended characters as unicode escape sequence.
-            int code = reinterpret_cast<const unsigned char&>(*it);
-            auto flags = stream.flags();
-            stream << "\\u" << std::setfill('0') << std::setw(4) << std::hex << code;
-            stream.flags(flags);
-          }
-          else stream << *it;
-        }
-      stream << '"';
-    }
-
-    std::ostream &serialize(std::ostream &stream, const Element &node, int indent)
-    {
-      bool compact = indent < 0;
+    std::uint32_t parseHexChar(Cursor &cursor) {
+      // Read the four hex digits of a "\u" escape sequence.
+      if(cursor.end - cursor.pos < 4) {
+        throwEndOfInput(cursor, "Unexpected end of file while reading character escape sequence.", cursor.end);
+      }
 
-      String thisIndent = String(String::size_type(compact ? 0 : indent), ' ');
-      String nextIndent = String(String::size_type(compact ? 0 : (indent + 2)), ' ');
+      std::uint32_t val = 0;
+      for(int i = 0; i < 4; ++i) {
+        int digit = hexDigit(cursor.pos[i]);
+        if(digit < 0) {
+          throwSyntaxError(cursor, "Invalid character escape sequence.", cursor.pos);
+        }
+        val = (val << 4) | std::uint32_t(digit);
+      }
+
+      cursor.pos += 4;
+      return val;
+    }
+
+    void parseCodeEscape(Cursor &cursor, String &str) {
+      // Read a "\u" escape sequence after the 'u' and append it as UTF-8.
+      // Characters above U+FFFF are written as a pair of escaped UTF-16 surrogates.
+      const char *first = cursor.pos;
+      std::uint32_t code = parseHexChar(cursor);
+
+      if(code >= 0xd800 && code <= 0xdbff) {
+        if(cursor.end - cursor.pos < 2) {
+          throwEndOfInput(cursor, "Unexpected end of file while reading character escape sequence.", cursor.end);
+        }
+        if(cursor.pos[0] != '\\' || cursor.pos[1] != 'u') {
+          throwSyntaxError(cursor, "Invalid surrogate pair in escape sequence.", first);
+        }
+        cursor.pos += 2;
+
+        std::uint32_t low = parseHexChar(cursor);
+        if(low < 0xdc00 || low > 0xdfff) {
+          throwSyntaxError(cursor, "Invalid surrogate pair in escape sequence.", first);
+        }
+        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+      }
+      else if(code >= 0xdc00 && code <= 0xdfff) {
+        throwSyntaxError(cursor, "Invalid surrogate pair in escape sequence.", first);
+      }
+
+      detail::encodeUtf8(code, str);
+    }
+
+    void checkRun(Cursor &cursor, const char *run) {
+      // The unescaped characters from run up to the current position must be valid UTF-8.
+      const char *invalid = detail::validateUtf8(run, cursor.pos);
+      if(invalid != cursor.pos) {
+        throwSyntaxError(cursor, "Invalid UTF-8 in string.", invalid);
+      }
+    }
+
+    template<bool keep>
+    void readString(Cursor &cursor, String &str) {
+      // Read string content up to and including terminating quote.
+      // Opening quote must have been previously consumed.
+      // Runs of unescaped characters are validated and appended in one go. Unless keep is set, the content
+      // is only checked, and str only holds the latest code escape.
+      // A string cut off by the end of a partial buffer is recorded in cursor.progress, and continued from
+      // there with the content kept so far in str once the same string is read from the extended buffer.
+
+      const char *quote = cursor.pos - 1;
+      const char *run = cursor.pos;
+      StringProgress *progress = cursor.progress;
+      if(progress && progress->resumes(quote - cursor.begin)) {
+        run = quote + progress->run;
+        cursor.pos = quote + progress->scanned;
+      }
+      else {
+        str.clear();
+      }
+
+      while(true) {
+        cursor.pos = detail::findStringSpecial(cursor.pos, cursor.end);
+        if(cursor.pos == cursor.end) {
+          break;
+        }
+
+        char in = *cursor.pos;
+
+        if(in == '"') {
+          checkRun(cursor, run);
+          if(keep) str.append(run, cursor.pos);
+          ++cursor.pos;
+          return;
+        }
+
+        if(in == '\\') {
+          checkRun(cursor, run);
+          if(keep) str.append(run, cursor.pos);
+          run = cursor.pos;
+          if(cursor.end - cursor.pos < 2) {
+            break;
+          }
+
+          ++cursor.pos;
+          char esc = *cursor.pos++;
+          char decoded;
+          if(esc == '\\') decoded = '\\';
+          else if(esc == '"') decoded = '"';
+          else if(esc == 'n') decoded = '\n';
+          else if(esc == 'r') decoded = '\r';
+          else if(esc == 't') decoded = '\t';
+          else if(esc == 'f') decoded = '\f';
+          else if(esc == 'b') decoded = '\b';
+          else if(esc == '/') decoded = '/';
+          else if(esc == 'u') {
+            if(!keep) str.clear();
+            try {
+              parseCodeEscape(cursor, str);
+            }
+            catch(Incomplete &) {
+              cursor.pos = run;
+              break;
+            }
+            run = cursor.pos;
+            continue;
+          }
+          else {
+            throwSyntaxError(cursor, "Illegal string escape sequence", cursor.pos - 1);
+          }
+
+          if(keep) str += decoded;
+          run = cursor.pos;
+          continue;
+        }
+
+        throwSyntaxError(cursor, "Control character in string.", cursor.pos);
+      }
+
+      if(progress && cursor.partial) {
+        progress->save(quote - cursor.begin, std::size_t(run - quote), std::size_t(cursor.pos - quote));
+      }
+      throwEndOfInput(cursor, "Unexpected end of file while parsing string.", cursor.end);
+    }
+
+    void parseString(Cursor &cursor, String &str) {
+      readString<true>(cursor, str);
+    }
+
+    void skipString(Cursor &cursor, String &scratch) {
+      // Check a string without keeping it. Code escapes are short enough not to allocate in scratch.
+      readString<false>(cursor, scratch);
+    }
+
+    const char *scanNumber(Cursor &cursor) {
+      // Skip the characters of the number starting at the current position and return its first character.
+      const char *first = cursor.pos;
+      while(cursor.pos < cursor.end) {
+        char in = *cursor.pos;
+        if((in < '0' || in > '9') && in != '-' && in != '+' && in != '.' && in != 'e' && in != 'E') {
+          break;
+        }
+        ++cursor.pos;
+      }
+
+      if(cursor.pos == cursor.end && cursor.partial) {
+        throw Incomplete();
+      }
+      return first;
+    }
+
+    void parseNumber(Cursor &cursor, const char *first, Number &num) {
+      // Convert the number in [first, cursor.pos) to floating point.
+      // This function is more permissive than the json standard, e.g. allowing leading '+'.
+      if(detail::parseNumber(first, cursor.pos, num)) {
+        return;
+      }
+
+      // Rare cases (long mantissas, out of range values, malformed input) go through strtod.
+      // strtod needs a terminated string, which the input buffer does not provide.
+      char small[64];
+      String large;
+      std::size_t length = std::size_t(cursor.pos - first);
+      const char *text;
+      if(length < sizeof(small)) {
+        std::memcpy(small, first, length);
+        small[length] = '\0';
+        text = small;
+      }
+      else {
+        large.assign(first, length);
+        text = large.c_str();
+      }
+
+      char *read;
+      errno = 0;
+      num = std::strtod(text, &read);
+      if(read == text) {
+        throwSyntaxError(cursor, "Failed to parse number", first);
+      }
+      if(errno == ERANGE && (num == 0 || std::isinf(num))) {
+        throwSyntaxError(cursor, "Failed to parse number, value out of range", first);
+      }
+      if(std::size_t(read - text) != length) {
+        throwSyntaxError(cursor, "Illegal number format.", first);
+      }
+    }
+
+    template<class HandlerType>
+    void parseNumber(Cursor &cursor, HandlerType &handler) {
+      // Read number starting at the current position. Integers are reported exactly if they fit in 64 bits,
+      // which also spares them the floating point conversion.
+      const char *first = scanNumber(cursor);
+
+      bool negative;
+      UnsignedInteger magnitude;
+      if(detail::parseInteger(first, cursor.pos, negative, magnitude)) {
+        if(negative) {
+          handler.onInteger(-Integer(magnitude - 1) - 1);
+        }
+        else if(magnitude <= UnsignedInteger(std::numeric_limits<Integer>::max())) {
+          handler.onInteger(Integer(magnitude));
+        }
+        else {
+          handler.onUnsignedInteger(magnitude);
+        }
+        return;
+      }
+
+      Number num;
+      parseNumber(cursor, first, num);
+      handler.onNumber(num);
+    }
+
+    void parseLiteral(Cursor &cursor, const char *literal, std::size_t length, const char *msg) {
+      // Read and verify one of the primitives "null", "true" or "false".
+      std::size_t available = std::size_t(cursor.end - cursor.pos);
+      if(available < length && cursor.partial && std::memcmp(cursor.pos, literal, available) == 0) {
+        throw Incomplete();
+      }
+      if(available < length || std::memcmp(cursor.pos, literal, length) != 0) {
+        throwSyntaxError(cursor, msg, cursor.pos + 1);
+      }
+      cursor.pos += length;
+    }
+
+    class Validator {
+      // Handler for validate, which ignores all events. Strings are checked without being decoded.
+    public:
+      void onNull() {}
+      void onBoolean(Boolean) {}
+      void onNumber(Number) {}
+      void onInteger(Integer) {}
+      void onUnsignedInteger(UnsignedInteger) {}
+      void onStartObject() {}
+      void onStartArray() {}
+      void onEndObject() {}
+      void onEndArray() {}
+    };
+
+    template<class HandlerType>
+    void parseStringValue(Cursor &cursor, HandlerType &handler, String &scratch) {
+      parseString(cursor, scratch);
+      handler.onString(scratch);
+    }
+
+    void parseStringValue(Cursor &cursor, Validator &, String &scratch) {
+      skipString(cursor, scratch);
+    }
+
+    template<class HandlerType>
+    void parseKey(Cursor &cursor, HandlerType &handler, String &scratch) {
+      parseString(cursor, scratch);
+      handler.onKey(scratch);
+    }
+
+    void parseKey(Cursor &cursor, Validator &, String &scratch) {
+      skipString(cursor, scratch);
+    }
+
+    template<class HandlerType>
+    void parsePrimitive(Cursor &cursor, HandlerType &handler, String &scratch) {
+      // Read a primitive (null, bool, number, string, not array or object) starting at the current position.
+
+      char first = *cursor.pos;
+
+      if(first == 'n') {
+        parseLiteral(cursor, "null", 4, "Expected \"null\"");
+        handler.onNull();
+      }
+      else if(first == 't') {
+        parseLiteral(cursor, "true", 4, "Expected \"true\"");
+        handler.onBoolean(true);
+      }
+      else if(first == 'f') {
+        parseLiteral(cursor, "false", 5, "Expected \"false\"");
+        handler.onBoolean(false);
+      }
+      else if(first == '"') {
+        ++cursor.pos;
+        parseStringValue(cursor, handler, scratch);
+      }
+      else if(first == '-' || (first >= '0' && first <= '9')) {
+        parseNumber(cursor, handler);
+      }
+      else {
+        throwSyntaxError(cursor, "Primitive must be one of null, true, false, number or quoted string.", cursor.pos);
+      }
+    }
+
+    void skipLineComment(Cursor &cursor) {
+      // The first '/' must have been consumed.
+      if(cursor.pos == cursor.end) {
+        throwEndOfInput(cursor, "Expected second '/' to begin line comment.", cursor.pos);
+      }
+      if(*cursor.pos != '/') {
+        throwSyntaxError(cursor, "Expected second '/' to begin line comment.", cursor.pos);
+      }
+
+      while(++cursor.pos < cursor.end) {
+        if(*cursor.pos == '\n' || *cursor.pos == '\r') {
+          ++cursor.pos;
+          return;
+        }
+      }
+
+      // The comment may continue in the next chunk.
+      if(cursor.partial) {
+        throw Incomplete();
+      }
+    }
+
+    void skipWhitespace(Cursor &cursor) {
+      // Skip whitespace and line comments.
+      if(cursor.index) {
+        const char *next = cursor.index->next(cursor.pos);
+        if(next) {
+          cursor.pos = next;
+          return;
+        }
+        // The index gave up on a comment, continue without it.
+        cursor.index = nullptr;
+      }
+
+      while(cursor.pos < cursor.end) {
+        char in = *cursor.pos;
+        if(in == ' ' || in == '\n' || in == '\r' || in == '\t') {
+          cursor.pos = detail::skipWhitespaceRun(cursor.pos + 1, cursor.end);
+        }
+        else if(in == '/') {
+          ++cursor.pos;
+          skipLineComment(cursor);
+        }
+        else {
+          break;
+        }
+      }
+    }
+
+    void skipValue(Cursor &cursor, String &scratch) {
+      // Step over the value at the current position without reporting it. Containers are skipped by
+      // matching brackets, and numbers and literals up to the next delimiter. Strings are checked, since
+      // they may hold brackets.
+      std::size_t depth = 0;
+
+      // Kind of each open bracket, a bit per level set for objects. Levels past 64 spill into deeper.
+      std::uint64_t objects = 0;
+      std::vector<bool> deeper;
+
+      const char *first = cursor.pos;
+      while(cursor.pos < cursor.end) {
+        char in = *cursor.pos;
+        if(in == '"') {
+          ++cursor.pos;
+          skipString(cursor, scratch);
+          if(!depth) return;
+        }
+        else if(in == '{' || in == '[') {
+          bool object = in == '{';
+          if(depth < 64) {
+            objects = (objects & ~(std::uint64_t(1) << depth)) | (std::uint64_t(object) << depth);
+          }
+          else {
+            deeper.push_back(object);
+          }
+          ++depth;
+          ++cursor.pos;
+        }
+        else if(in == '}' || in == ']') {
+          if(!depth) break;
+          --depth;
+          bool object = depth < 64 ? (objects >> depth) & 1 : deeper.back();
+          if(depth >= 64) {
+            deeper.pop_back();
+          }
+          if(object != (in == '}')) {
+            throwSyntaxError(cursor, object ? "Token ']' is illegal inside object." : "Token '}' is illegal inside array.",
+                             cursor.pos);
+          }
+          ++cursor.pos;
+          if(!depth) return;
+        }
+        else if(in == ',' || in == ':') {
+          if(!depth) break;
+          ++cursor.pos;
+        }
+        else if(in == '/' && depth) {
+          ++cursor.pos;
+          skipLineComment(cursor);
+        }
+        else if(!depth && (in == ' ' || in == '\t' || in == '\n' || in == '\r' || in == '/')) {
+          break;
+        }
+        else {
+          ++cursor.pos;
+        }
+      }
+
+      if(depth) {
+        throwEndOfInput(cursor, "Unexpected end of file.", cursor.end);
+      }
+      if(cursor.pos == first) {
+        throwSyntaxError(cursor, "Primitive must be one of null, true, false, number or quoted string.", cursor.pos);
+      }
+    }
+
+    class Projector;
+    bool selectValue(Projector &projector, char in);
+
+    class Navigator;
+    bool selectValue(Navigator &navigator, char in);
+    void parseStringValue(Cursor &cursor, Navigator &, String &scratch);
+
+    template<class HandlerType>
+    bool selectValue(HandlerType &, char) {
+      // Whether the value starting with in is wanted by the handler, or should be skipped.
+      return true;
+    }
+
+    enum State {
+        S_PRE_ELEMENT,   // Read an element (root, array item or object value) or close parent array.
+        S_PRE_KEY,       // Inside object, read quoted key name or close object.
+        S_PRE_SEP,       // Inside object (after key), read ':' before value.
+        S_POST_ELEMENT,  // After complete element (key+value if parent is obj). Read comma, close parent array/object or finish.
+    };
+
+    struct ParseState {
+      // Everything the parser needs to continue after the last complete token.
+      ParseState():state(S_PRE_ELEMENT),multiple(false) {
+        scopes.reserve(32);
+      }
+
+      void reset() {
+        state = S_PRE_ELEMENT;
+        scopes.clear();
+        progress.clear();
+      }
+
+      bool complete() const {
+        return state == S_POST_ELEMENT && scopes.empty();
+      }
+
+      State state;
+
+      // Open arrays and objects, innermost last. Empty before the root and after it is complete.
+      std::vector<Element::Type> scopes;
+
+      // Strings and keys are read into this buffer before they are passed on.
+      String scratch;
+
+      // The string the last partial buffer ended in, which is resumed with its content so far in scratch.
+      StringProgress progress;
+
+      // Set if further documents may follow the root. Parsing then stops at the start of the next one,
+      // and input without any document is not an error.
+      bool multiple;
+    };
+
+    template<class HandlerType>
+    bool parse(Cursor &cursor, ParseState &parseState, HandlerType &handler)
+    {
+      // Parse tokens up to the end of the cursor and return whether the document is complete.
+      // If the cursor is partial, a token cut off by the end is left unread and the cursor points at it.
+      // Otherwise an incomplete document is an error.
+
+      State &state = parseState.state;
+      std::vector<Element::Type> &scopes = parseState.scopes;
+      String &scratch = parseState.scratch;
+
+      const char *token = cursor.pos;
+      cursor.progress = &parseState.progress;
+
+      try {
+        // Each state either consumes the current character or switches state and leaves it for the next one.
+        while(true) {
+          token = cursor.pos;
+          skipWhitespace(cursor);
+          if(cursor.pos == cursor.end) {
+            break;
+          }
+
+          char in = *cursor.pos;
+
+          switch(state) {
+
+            case S_PRE_KEY: {
+              if(in == '"') {
+                ++cursor.pos;
+                parseKey(cursor, handler, scratch);
+                state = S_PRE_SEP;
+              }
+              else if(in == '}') {
+                state = S_POST_ELEMENT;
+              }
+              else {
+                throwSyntaxError(cursor, "Expected key or closing bracket.", cursor.pos);
+              }
+            } break;
+
+            case S_PRE_SEP: {
+              if(in != ':') {
+                throwSyntaxError(cursor, "Expected ':' separating key and value.", cursor.pos);
+              }
+              ++cursor.pos;
+              state = S_PRE_ELEMENT;
+            } break;
+
+            case S_PRE_ELEMENT: {
+              if(in == ']' && !scopes.empty() && scopes.back() == Element::ARRAY) {
+                state = S_POST_ELEMENT;
+              }
+              else if(!selectValue(handler, in)) {
+                skipValue(cursor, scratch);
+                state = S_POST_ELEMENT;
+              }
+              else if(in == '[') {
+                ++cursor.pos;
+                scopes.push_back(Element::ARRAY);
+                handler.onStartArray();
+                state = S_PRE_ELEMENT;
+              }
+              else if(in == '{') {
+                ++cursor.pos;
+                scopes.push_back(Element::OBJECT);
+                handler.onStartObject();
+                state = S_PRE_KEY;
+              }
+              else {
+                parsePrimitive(cursor, handler, scratch);
+                state = S_POST_ELEMENT;
+              }
+            } break;
+
+            case S_POST_ELEMENT: {
+              if(scopes.empty()) {
+                if(parseState.multiple) {
+                  return true;
+                }
+                throwSyntaxError(cursor, "Input after end.", cursor.pos);
+              }
+
+              if(in == ',') {
+                state = scopes.back() == Element::ARRAY ? S_PRE_ELEMENT : S_PRE_KEY;
+              }
+              else if(in == ']') {
+                if(scopes.back() != Element::ARRAY) {
+                  throwSyntaxError(cursor, "Token ']' is illegal inside object.", cursor.pos);
+                }
+                scopes.pop_back();
+                handler.onEndArray();
+                state = S_POST_ELEMENT;
+              }
+              else if(in == '}') {
+                if(scopes.back() != Element::OBJECT) {
+                  throwSyntaxError(cursor, "Token '}' is illegal inside array.", cursor.pos);
+                }
+                scopes.pop_back();
+                handler.onEndObject();
+                state = S_POST_ELEMENT;
+              }
+              else {
+                throwSyntaxError(cursor, "Expected ',' or closing bracket.", cursor.pos);
+              }
+              ++cursor.pos;
+            } break;
+
+          }
+        }
+      }
+      catch(Incomplete &) {
+        cursor.pos = token;
+        parseState.progress.rebase(token - cursor.begin);
+        return parseState.complete();
+      }
+
+      bool empty = parseState.multiple && state == S_PRE_ELEMENT && scopes.empty();
+      if(!parseState.complete() && !cursor.partial && !empty) {
+        throwSyntaxError(cursor, "Unexpected end of file.", cursor.end);
+      }
+      return parseState.complete();
+    }
+
+    template<class HandlerType>
+    void parse(const char *data, std::size_t size, HandlerType &handler)
+    {
+      Cursor cursor(data, size);
+
+      if(worthIndexing(size)) {
+        detail::StructuralIndex index(data, size);
+        cursor.index = &index;
+        ParseState state;
+        parse(cursor, state, handler);
+      }
+      else {
+        ParseState state;
+        parse(cursor, state, handler);
+      }
+    }
+
+    class DomBuilder {
+      // Handler building an element tree, used by deserialize.
+      // Not derived from Handler so that the parser calls it directly rather than through the vtable.
+    public:
+      DomBuilder(Element &root, const Allocator<char> &allocator = Allocator<char>())
+        :root(root),
+         allocator(allocator)
+      {
+        root = Element::NULL_VALUE;
+        nodes.reserve(32);
+      }
+
+      void onNull() { insert(Element()); }
+      void onBoolean(Boolean value) { insert(Element(value)); }
+      void onNumber(Number value) { insert(Element(value)); }
+      void onInteger(Integer value) { insert(Element(value)); }
+      void onUnsignedInteger(UnsignedInteger value) { insert(Element(value)); }
+      void onString(String &value) { insert(Element(std::move(value), allocator)); }
+      void onKey(String &value) {
+        // Repeated keys, e.g. in an array of records, share one key.
+        std::size_t hash = detail::hashKey(value.data(), value.size());
+        Key &cached = keys[hash % KEY_CACHE_SIZE];
+        if(!cached.equals(value.data(), value.size(), hash)) {
+          cached = Key(std::move(value));
+        }
+        key = cached;
+      }
+      void onStartObject() { nodes.push_back(&insert(Element(Element::OBJECT, allocator))); }
+      void onStartArray() { nodes.push_back(&insert(Element(Element::ARRAY, allocator))); }
+      void onEndObject() { nodes.pop_back(); }
+      void onEndArray() { nodes.pop_back(); }
+
+    private:
+      Element &insert(Element &&el) {
+        // Add a completed value or an empty container to the innermost open container.
+        if(nodes.empty()) {
+          root = std::move(el);
+          return root;
+        }
+
+        // The payloads are used directly, as the mutable accessors would stop the new tree from being shared.
+        Element &parent = *nodes.back();
+        if(parent.isArray()) {
+          Array &array = parent._array->value;
+          array.push_back(std::move(el));
+          return array.back();
+        }
+
+        Element &child = parent._object->value[std::move(key)];
+        child = std::move(el);
+        return child;
+      }
+
+      Element &root;
+
+      // Storage for containers and strings, the heap unless parsing into a Document.
+      Allocator<char> allocator;
+
+      // Open containers. Parents of any element in the stack must not be modified as a reallocation would be very bad.
+      std::vector<Element*> nodes;
+
+      // Key for the next value inside an object.
+      Key key;
+
+      // Recently seen keys, by hash.
+      static const std::size_t KEY_CACHE_SIZE = 64;
+      Key keys[KEY_CACHE_SIZE];
+    };
+
+    namespace detail {
+      // Tape word layout, see Tape.
+      const std::uint64_t TAPE_PAYLOAD = 0x00ffffffffffffffULL;
+      const std::uint64_t TAPE_POSITION = 0xffffffffULL;
+      const std::uint64_t TAPE_MAX_COUNT = 0xffffffULL;
+
+      inline std::uint64_t tapeWord(char tag, std::uint64_t payload) {
+        return std::uint64_t(static_cast<unsigned char>(tag)) << 56 | payload;
+      }
+
+      inline char tapeTag(std::uint64_t word) {
+        return char(word >> 56);
+      }
+
+      template<typename To, typename From>
+      To bitCast(From from) {
+        static_assert(sizeof(To) == sizeof(From), "Size mismatch.");
+        To to;
+        std::memcpy(&to, &from, sizeof(to));
+        return to;
+      }
+
+      inline std::uint32_t tapeStringLength(const String &strings, std::uint64_t word) {
+        std::uint32_t length;
+        std::memcpy(&length, strings.data() + (word & TAPE_PAYLOAD), sizeof(length));
+        return length;
+      }
+
+      template<class HandlerType>
+      void replayTape(const std::vector<std::uint64_t> &words, const String &strings, std::size_t begin,
+                      std::size_t end, HandlerType &handler) {
+        // Report the values in [begin, end) to handler as if they were parsed again.
+        std::vector<bool> objects;  // Open containers, innermost last, set for objects.
+        bool key = false;           // Set if the next string is a key.
+        String scratch;
+
+        for(std::size_t position = begin; position < end; ++position) {
+          std::uint64_t word = words[position];
+          char tag = tapeTag(word);
+          switch(tag) {
+            case 'n': handler.onNull(); break;
+            case 't': handler.onBoolean(true); break;
+            case 'f': handler.onBoolean(false); break;
+            case 'd': handler.onNumber(bitCast<Number>(words[++position])); break;
+            case 'l': handler.onInteger(bitCast<Integer>(words[++position])); break;
+            case 'u': handler.onUnsignedInteger(words[++position]); break;
+            case '"':
+              scratch.assign(strings.data() + (word & TAPE_PAYLOAD) + sizeof(std::uint32_t),
+                             tapeStringLength(strings, word));
+              if(key) {
+                handler.onKey(scratch);
+              }
+              else {
+                handler.onString(scratch);
+              }
+              break;
+            case '{':
+              handler.onStartObject();
+              objects.push_back(true);
+              key = true;
+              continue;
+            case '[':
+              handler.onStartArray();
+              objects.push_back(false);
+              key = false;
+              continue;
+            case '}':
+              handler.onEndObject();
+              objects.pop_back();
+              break;
+            case ']':
+              handler.onEndArray();
+              objects.pop_back();
+              break;
+          }
+          // A key is followed by its value, any other value inside an object by the next key.
+          key = !(key && tag == '"') && !objects.empty() && objects.back();
+        }
+      }
+    }
+
+    class Projector {
+      // Handler passing the values selected by a projection, and their parents, on to a DomBuilder. The
+      // parser asks it about each value before reading it, and skips the ones it does not want.
+    public:
+      Projector(DomBuilder &builder, const Projection &projection)
+        :builder(builder),
+         nodes(projection.nodes),
+         passDepth(0),
+         passNext(false)
+      {
+        if(!nodes.empty()) {
+          pending.push_back(0);
+        }
+      }
+
+      bool select(char in) {
+        if(passDepth) {
+          return true;
+        }
+
+        bool inArray = !frames.empty() && frames.back().array;
+        if(inArray) {
+          // Match the index against the tokens, written out without allocating.
+          char digits[24];
+          char *first = digits + sizeof(digits);
+          std::size_t index = frames.back().index++;
+          do {
+            *--first = char('0' + index % 10);
+            index /= 10;
+          } while(index);
+          match(first, std::size_t(digits + sizeof(digits) - first));
+        }
+
+        bool selected = false;
+        for(std::size_t i = 0; i < pending.size(); ++i) {
+          selected = selected || nodes[pending[i]].selected;
+        }
+
+        // Containers are entered if a path continues below them, primitives only if one ends at them.
+        if(selected || (!pending.empty() && (in == '{' || in == '['))) {
+          passNext = selected;
+          if(!frames.empty() && !inArray) {
+            builder.onKey(key);
+          }
+          return true;
+        }
+
+        if(inArray) {
+          builder.onNull();
+        }
+        return false;
+      }
+
+      void onNull() { passNext = false; builder.onNull(); }
+      void onBoolean(Boolean value) { passNext = false; builder.onBoolean(value); }
+      void onNumber(Number value) { passNext = false; builder.onNumber(value); }
+      void onInteger(Integer value) { passNext = false; builder.onInteger(value); }
+      void onUnsignedInteger(UnsignedInteger value) { passNext = false; builder.onUnsignedInteger(value); }
+      void onString(String &value) { passNext = false; builder.onString(value); }
+
+      void onKey(String &value) {
+        if(passDepth) {
+          builder.onKey(value);
+          return;
+        }
+        // Kept until the value is selected. Swapping hands the parser the previous key's buffer to reuse.
+        match(value.data(), value.size());
+        key.swap(value);
+      }
+
+      void onStartObject() { start(false); builder.onStartObject(); }
+      void onStartArray() { start(true); builder.onStartArray(); }
+      void onEndObject() { end(); builder.onEndObject(); }
+      void onEndArray() { end(); builder.onEndArray(); }
+
+    private:
+      struct Frame {
+        std::size_t begin;  // Position of the container's nodes in active.
+        std::size_t index;  // Next array index.
+        bool array;
+      };
+
+      void match(const char *token, std::size_t size) {
+        // Find the nodes for a key or index of the innermost container.
+        pending.clear();
+        for(std::size_t i = frames.back().begin; i < active.size(); ++i) {
+          const Projection::Node &node = nodes[active[i]];
+          for(std::size_t j = 0; j < node.children.size(); ++j) {
+            const String &child = node.children[j].first;
+            if(child.size() == size && child.compare(0, size, token, size) == 0) {
+              pending.push_back(node.children[j].second);
+            }
+          }
+          if(node.wildcard) {
+            pending.push_back(node.wildcard);
+          }
+        }
+      }
+
+      void start(bool array) {
+        if(passDepth || passNext) {
+          ++passDepth;
+          passNext = false;
+          return;
+        }
+        Frame frame = {active.size(), 0, array};
+        frames.push_back(frame);
+        active.insert(active.end(), pending.begin(), pending.end());
+      }
+
+      void end() {
+        if(passDepth) {
+          --passDepth;
+          return;
+        }
+        active.resize(frames.back().begin);
+        frames.pop_back();
+      }
+
+      DomBuilder &builder;
+      const std::vector<Projection::Node> &nodes;
+
+      // Nodes matching each open container, and the nodes for the next value.
+      std::vector<Frame> frames;
+      std::vector<std::uint32_t> active;
+      std::vector<std::uint32_t> pending;
+
+      // Key of the next value inside an object.
+      String key;
+
+      // Depth inside a selected container, whose contents are all passed on, and whether the next value
+      // is selected as a whole.
+      std::size_t passDepth;
+      bool passNext;
+    };
+
+    bool selectValue(Projector &projector, char in) {
+      return projector.select(in);
+    }
+
+    Projection::Projection(std::initializer_list<String> paths) {
+      for(std::initializer_list<String>::const_iterator it = paths.begin(); it != paths.end(); ++it) {
+        add(*it);
+      }
+    }
+
+    std::vector<String> splitPointer(const String &path) {
+      // Split a JSON Pointer into its unescaped tokens.
+      if(!path.empty() && path[0] != '/') {
+        throw std::invalid_argument("JSON Pointer must be empty or start with '/'.");
+      }
+
+      std::vector<String> tokens;
+      for(std::size_t pos = 0; pos < path.size();) {
+        std::size_t end = path.find('/', pos + 1);
+        if(end == String::npos) {
+          end = path.size();
+        }
+
+        // Unescape "~1" to '/' and "~0" to '~'.
+        String token;
+        for(std::size_t i = pos + 1; i < end; ++i) {
+          if(path[i] != '~') {
+            token += path[i];
+          }
+          else if(i + 1 < end && (path[i + 1] == '0' || path[i + 1] == '1')) {
+            token += path[++i] == '0' ? '~' : '/';
+          }
+          else {
+            throw std::invalid_argument("JSON Pointer has '~' not followed by '0' or '1'.");
+          }
+        }
+        tokens.push_back(std::move(token));
+        pos = end;
+      }
+      return tokens;
+    }
+
+    void Projection::add(const String &path) {
+      std::vector<String> tokens = splitPointer(path);
+      if(nodes.empty()) {
+        nodes.push_back(Node());
+      }
+
+      std::uint32_t node = 0;
+      for(std::size_t t = 0; t < tokens.size(); ++t) {
+        String &token = tokens[t];
+        std::uint32_t next = 0;
+        if(token == "*") {
+          next = nodes[node].wildcard;
+        }
+        else {
+          for(std::size_t i = 0; i < nodes[node].children.size() && !next; ++i) {
+            if(nodes[node].children[i].first == token) {
+              next = nodes[node].children[i].second;
+            }
+          }
+        }
+
+        if(!next) {
+          next = std::uint32_t(nodes.size());
+          if(token == "*") {
+            nodes[node].wildcard = next;
+          }
+          else {
+            nodes[node].children.push_back(std::make_pair(std::move(token), next));
+          }
+          nodes.push_back(Node());
+        }
+        node = next;
+      }
+
+      nodes[node].selected = true;
+    }
+
+    class TapeBuilder {
+      // Handler writing a tape, used by deserialize.
+    public:
+      TapeBuilder(Tape &tape, std::size_t size)
+        :words(tape.words),
+         strings(tape.strings)
+      {
+        words.clear();
+        strings.clear();
+        // Rough upper bounds for typical documents, so the buffers are rarely grown while parsing.
+        words.reserve(size / 4 + 2);
+        strings.reserve(size / 2);
+        open.reserve(32);
+      }
+
+      void onNull() { value(); words.push_back(detail::tapeWord('n', 0)); }
+      void onBoolean(Boolean value) { this->value(); words.push_back(detail::tapeWord(value ? 't' : 'f', 0)); }
+      void onNumber(Number value) { scalar('d', detail::bitCast<std::uint64_t>(value)); }
+      void onInteger(Integer value) { scalar('l', std::uint64_t(value)); }
+      void onUnsignedInteger(UnsignedInteger value) { scalar('u', value); }
+      void onString(String &value) { this->value(); string(value); }
+      void onKey(String &value) { string(value); }
+      void onStartObject() { start('{'); }
+      void onStartArray() { start('['); }
+      void onEndObject() { end('}'); }
+      void onEndArray() { end(']'); }
+
+    private:
+      void value() {
+        if(!open.empty()) {
+          ++open.back().second;
+        }
+      }
+
+      void scalar(char tag, std::uint64_t bits) {
+        value();
+        words.push_back(detail::tapeWord(tag, 0));
+        words.push_back(bits);
+      }
+
+      void string(const String &str) {
+        if(str.size() > std::numeric_limits<std::uint32_t>::max()) {
+          throw std::length_error("String too long for tape.");
+        }
+        words.push_back(detail::tapeWord('"', strings.size()));
+        std::uint32_t length = std::uint32_t(str.size());
+        strings.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        strings.append(str);
+        strings.push_back('\0');
+      }
+
+      void start(char tag) {
+        value();
+        open.push_back(std::make_pair(words.size(), std::uint64_t(0)));
+        words.push_back(detail::tapeWord(tag, 0));
+      }
+
+      void end(char tag) {
+        std::size_t start = open.back().first;
+        std::uint64_t count = std::min(open.back().second, detail::TAPE_MAX_COUNT);
+        open.pop_back();
+
+        std::uint64_t next = words.size() + 1;
+        if(next > detail::TAPE_POSITION) {
+          throw std::length_error("Document too large for tape.");
+        }
+        words[start] |= count << 32 | next;
+        words.push_back(detail::tapeWord(tag, start));
+      }
+
+      std::vector<std::uint64_t> &words;
+      String &strings;
+
+      // Start positions and entry counts of open containers.
+      std::vector<std::pair<std::size_t, std::uint64_t>> open;
+    };
+
+    Tape::Tape()
+      :words(1, detail::tapeWord('n', 0))
+    {}
+
+    Tape::Value Tape::root() const {
+      return Value(this, 0);
+    }
+
+    void Tape::clear() {
+      words.assign(1, detail::tapeWord('n', 0));
+      strings.clear();
+    }
+
+    Element::Type Tape::Value::getType() const {
+      if(!tape) return Element::NULL_VALUE;
+      switch(detail::tapeTag(tape->words[position])) {
+        case '{': return Element::OBJECT;
+        case '[': return Element::ARRAY;
+        case '"': return Element::STRING;
+        case 'd': case 'l': case 'u': return Element::NUMBER;
+        case 't': case 'f': return Element::BOOLEAN;
+        default: return Element::NULL_VALUE;
+      }
+    }
+
+    const char *Tape::Value::getTypeName() const {
+      return typeName(getType());
+    }
+
+    Element::NumberType Tape::Value::getNumberType() const {
+      switch(detail::tapeTag(tape ? tape->words[position] : 0)) {
+        case 'd': return Element::FLOATING_POINT;
+        case 'l': return Element::SIGNED_INTEGER;
+        case 'u': return Element::UNSIGNED_INTEGER;
+        default: throw TypeError(Element::NUMBER);
+      }
+    }
+
+    Tape::Object Tape::Value::object() const {
+      if(!isObject()) throw TypeError(Element::OBJECT);
+      return Object(*this);
+    }
+
+    Tape::Array Tape::Value::array() const {
+      if(!isArray()) throw TypeError(Element::ARRAY);
+      return Array(*this);
+    }
+
+    Boolean Tape::Value::boolean() const {
+      if(!isBoolean()) throw TypeError(Element::BOOLEAN);
+      return detail::tapeTag(tape->words[position]) == 't';
+    }
+
+    Number Tape::Value::number() const {
+      switch(getNumberType()) {
+        case Element::SIGNED_INTEGER: return Number(detail::bitCast<Integer>(tape->words[position + 1]));
+        case Element::UNSIGNED_INTEGER: return Number(tape->words[position + 1]);
+        default: return detail::bitCast<Number>(tape->words[position + 1]);
+      }
+    }
+
+    Integer Tape::Value::integer() const {
+      // Converted like the numbers of an Element, see Element::integer.
+      switch(getNumberType()) {
+        case Element::SIGNED_INTEGER:
+          return detail::bitCast<Integer>(tape->words[position + 1]);
+        case Element::UNSIGNED_INTEGER: {
+          UnsignedInteger value = tape->words[position + 1];
+          if(value > UnsignedInteger(std::numeric_limits<Integer>::max())) break;
+          return Integer(value);
+        }
+        default: {
+          Number value = detail::bitCast<Number>(tape->words[position + 1]);
+          if(!(value >= -9223372036854775808.0 && value < 9223372036854775808.0)) break;
+          return Integer(value);
+        }
+      }
+      throw TypeError("TypeError: Number out of range.");
+    }
+
+    UnsignedInteger Tape::Value::unsignedInteger() const {
+      switch(getNumberType()) {
+        case Element::SIGNED_INTEGER: {
+          Integer value = detail::bitCast<Integer>(tape->words[position + 1]);
+          if(value < 0) break;
+          return UnsignedInteger(value);
+        }
+        case Element::UNSIGNED_INTEGER:
+          return tape->words[position + 1];
+        default: {
+          Number value = detail::bitCast<Number>(tape->words[position + 1]);
+          if(!(value > -1.0 && value < 18446744073709551616.0)) break;
+          return UnsignedInteger(value);
+        }
+      }
+      throw TypeError("TypeError: Number out of range.");
+    }
+
+    String Tape::Value::str() const {
+      return String(c_str(), length());
+    }
+
+    const char *Tape::Value::c_str() const {
+      if(!isString()) throw TypeError(Element::STRING);
+      return tape->strings.data() + (tape->words[position] & detail::TAPE_PAYLOAD) + sizeof(std::uint32_t);
+    }
+
+    std::size_t Tape::Value::length() const {
+      if(!isString()) throw TypeError(Element::STRING);
+      return detail::tapeStringLength(tape->strings, tape->words[position]);
+    }
+
+    Element Tape::Value::toElement() const {
+      Element element;
+      if(tape) {
+        DomBuilder builder(element);
+        detail::replayTape(tape->words, tape->strings, position, next(), builder);
+      }
+      return element;
+    }
+
+    std::size_t Tape::Value::next() const {
+      std::uint64_t word = tape->words[position];
+      switch(detail::tapeTag(word)) {
+        case '{': case '[': return std::size_t(word & detail::TAPE_POSITION);
+        case 'd': case 'l': case 'u': return position + 2;
+        default: return position + 1;
+      }
+    }
+
+    Tape::Array::const_iterator Tape::Array::begin() const {
+      return const_iterator(Value(start.tape, start.position + 1));
+    }
+
+    Tape::Array::const_iterator Tape::Array::end() const {
+      return const_iterator(Value(start.tape, start.next() - 1));
+    }
+
+    std::size_t Tape::Array::size() const {
+      std::uint64_t count = start.tape->words[start.position] >> 32 & detail::TAPE_MAX_COUNT;
+      if(count < detail::TAPE_MAX_COUNT) {
+        return std::size_t(count);
+      }
+      return std::size_t(std::distance(begin(), end()));
+    }
+
+    Tape::Value Tape::Array::at(std::size_t index) const {
+      const_iterator it = begin(), last = end();
+      for(; it != last && index > 0; ++it, --index) {}
+      if(it == last) throw std::out_of_range("Tape::Array::at");
+      return *it;
+    }
+
+    Tape::Object::const_iterator::const_iterator(const Value &key)
+      :entry(key, Value(key.tape, key.position + 1)) {}
+
+    Tape::Object::const_iterator &Tape::Object::const_iterator::operator ++() {
+      *this = const_iterator(Value(entry.second.tape, entry.second.next()));
+      return *this;
+    }
+
+    Tape::Object::const_iterator Tape::Object::begin() const {
+      return const_iterator(Value(start.tape, start.position + 1));
+    }
+
+    Tape::Object::const_iterator Tape::Object::end() const {
+      return const_iterator(Value(start.tape, start.next() - 1));
+    }
+
+    std::size_t Tape::Object::size() const {
+      std::uint64_t count = start.tape->words[start.position] >> 32 & detail::TAPE_MAX_COUNT;
+      if(count < detail::TAPE_MAX_COUNT) {
+        return std::size_t(count);
+      }
+      return std::size_t(std::distance(begin(), end()));
+    }
+
+    Tape::Object::const_iterator Tape::Object::find(const char *data, std::size_t size) const {
+      const_iterator it = begin(), last = end();
+      for(; it != last; ++it) {
+        if(it->first.length() == size && std::memcmp(it->first.c_str(), data, size) == 0) {
+          break;
+        }
+      }
+      return it;
+    }
+
+    Tape::Object::const_iterator Tape::Object::find(const String &key) const {
+      return find(key.data(), key.size());
+    }
+
+    Tape::Object::const_iterator Tape::Object::find(const char *key) const {
+      return find(key, std::strlen(key));
+    }
+
+    Tape::Value Tape::Object::at(const String &key) const {
+      const_iterator it = find(key);
+      if(it == end()) throw std::out_of_range("Tape::Object::at");
+      return it->second;
+    }
+
+    class ScalarBuilder {
+      // Handler for a single primitive, used where no containers can occur.
+    public:
+      explicit ScalarBuilder(Element &element):element(element) {}
+
+      void onNull() { element = Element(); }
+      void onBoolean(Boolean value) { element = Element(value); }
+      void onNumber(Number value) { element = Element(value); }
+      void onInteger(Integer value) { element = Element(value); }
+      void onUnsignedInteger(UnsignedInteger value) { element = Element(value); }
+      void onString(String &value) { element = Element(std::move(value)); }
+
+    private:
+      Element &element;
+    };
+
+    void expectValueEnd(Cursor &cursor, const char *documentEnd) {
+      // Only whitespace and comments may follow a value up to the next structural character, which must
+      // be one that ends it, such as "1 2" or "\"a\"b" would otherwise pass as their first value.
+      skipWhitespace(cursor);
+      if(cursor.pos == cursor.end) {
+        char in = cursor.end < documentEnd ? *cursor.end : ',';
+        if(in == ',' || in == ':' || in == ']' || in == '}') {
+          return;
+        }
+      }
+      throwSyntaxError(cursor, "Expected ',' or closing bracket.", cursor.pos);
+    }
+
+    LazyDocument::LazyDocument()
+      :data(nullptr),size(0)
+    {}
+
+    LazyDocument::Value LazyDocument::root() const {
+      return positions.empty() ? Value() : Value(this, 0);
+    }
+
+    void LazyDocument::clear() {
+      file.close();
+      data = nullptr;
+      size = 0;
+      positions.clear();
+      decoded.clear();
+    }
+
+    void LazyDocument::index(const char *data, std::size_t size) {
+      try {
+        if(size > std::numeric_limits<std::uint32_t>::max()) {
+          throw std::length_error("Input too large for lazy parsing.");
+        }
+
+        Cursor cursor(data, size);
+        if(!detail::indexStructurals(data, size, positions)) {
+          throwSyntaxError(cursor, "Unexpected end of file while parsing string.", data + size);
+        }
+
+        // Match brackets, and check that there is a single root value.
+        std::vector<char> open;
+        bool complete = false;
+        for(std::size_t i = 0; i < positions.size(); ++i) {
+          const char *at = data + positions[i];
+          if(complete) {
+            throwSyntaxError(cursor, "Input after end.", at);
+          }
+
+          char in = *at;
+          if(in == '{' || in == '[') {
+            open.push_back(in);
+          }
+          else if(open.empty() && (in == '}' || in == ']' || in == ',' || in == ':')) {
+            throwSyntaxError(cursor, "Primitive must be one of null, true, false, number or quoted string.", at);
+          }
+          else if(in == '}' || in == ']') {
+            if(in == '}' && open.back() != '{') {
+              throwSyntaxError(cursor, "Token '}' is illegal inside array.", at);
+            }
+            if(in == ']' && open.back() != '[') {
+              throwSyntaxError(cursor, "Token ']' is illegal inside object.", at);
+            }
+            open.pop_back();
+          }
+          complete = open.empty();
+        }
+
+        if(!complete) {
+          throwSyntaxError(cursor, "Unexpected end of file.", data + size);
+        }
+      }
+      catch(...) {
+        clear();
+        throw;
+      }
+
+      this->data = data;
+      this->size = size;
+    }
+
+    const char *LazyDocument::Value::at(std::size_t position) const {
+      const std::vector<std::uint32_t> &positions = document->positions;
+      return document->data + (position < positions.size() ? positions[position] : document->size);
+    }
+
+    void LazyDocument::Value::fail(const char *msg, std::size_t position) const {
+      throwSyntaxError(Cursor(document->data, document->size), msg, at(position));
+    }
+
+    void LazyDocument::Value::check() const {
+      switch(*at(index)) {
+        case ',': case ':': case ']': case '}':
+          fail("Primitive must be one of null, true, false, number or quoted string.", index);
+        default:
+          break;
+      }
+    }
+
+    Element::Type LazyDocument::Value::getType() const {
+      if(!document) return Element::NULL_VALUE;
+      switch(*at(index)) {
+        case '{': return Element::OBJECT;
+        case '[': return Element::ARRAY;
+        case '"': return Element::STRING;
+        case 't': case 'f': return Element::BOOLEAN;
+        case 'n': return Element::NULL_VALUE;
+        default: return Element::NUMBER;
+      }
+    }
+
+    const char *LazyDocument::Value::getTypeName() const {
+      return typeName(getType());
+    }
+
+    LazyDocument::Object LazyDocument::Value::object() const {
+      if(!isObject()) throw TypeError(Element::OBJECT);
+      return Object(*this);
+    }
+
+    LazyDocument::Array LazyDocument::Value::array() const {
+      if(!isArray()) throw TypeError(Element::ARRAY);
+      return Array(*this);
+    }
+
+    Boolean LazyDocument::Value::boolean() const {
+      if(!isBoolean()) throw TypeError(Element::BOOLEAN);
+      return decode().boolean();
+    }
+
+    Number LazyDocument::Value::number() const {
+      if(!isNumber()) throw TypeError(Element::NUMBER);
+      return decode().number();
+    }
+
+    Integer LazyDocument::Value::integer() const {
+      if(!isNumber()) throw TypeError(Element::NUMBER);
+      return decode().integer();
+    }
+
+    UnsignedInteger LazyDocument::Value::unsignedInteger() const {
+      if(!isNumber()) throw TypeError(Element::NUMBER);
+      return decode().unsignedInteger();
+    }
+
+    String LazyDocument::Value::str() const {
+      return view().str();
+    }
+
+    StringView LazyDocument::Value::view() const {
+      if(!isString()) throw TypeError(Element::STRING);
+
+      Cursor cursor(document->data, document->size);
+      const char *begin = at(index) + 1;
+      cursor.end = at(index + 1);
+      cursor.pos = detail::findStringSpecial(begin, cursor.end);
+      if(cursor.pos < cursor.end && *cursor.pos == '"') {
+        const char *special = cursor.pos;
+        const char *invalid = detail::validateUtf8(begin, special);
+        if(invalid != special) {
+          throwSyntaxError(cursor, "Invalid UTF-8 in string.", invalid);
+        }
+        ++cursor.pos;
+        expectValueEnd(cursor, document->data + document->size);
+        return StringView(begin, std::size_t(special - begin));
+      }
+
+      // Strings with escapes are decoded once and kept by the document.
+      std::unordered_map<std::size_t, String> &decoded = document->decoded;
+      std::unordered_map<std::size_t, String>::const_iterator it = decoded.find(index);
+      if(it == decoded.end()) {
+        String text;
+        cursor.pos = begin;
+        parseString(cursor, text);
+        expectValueEnd(cursor, document->data + document->size);
+        it = decoded.emplace(index, std::move(text)).first;
+      }
+      return StringView(it->second.data(), it->second.size());
+    }
+
+    Element LazyDocument::Value::toElement() const {
+      Element element;
+      if(!document) return element;
+      if(!isObject() && !isArray()) return decode();
+
+      // Parse the value's own slice of the input, so errors report lines from the start of the document.
+      Cursor cursor(document->data, document->size);
+      cursor.pos = at(index);
+      cursor.end = at(next() - 1) + 1;
+
+      ParseState state;
+      DomBuilder builder(element);
+      parse(cursor, state, builder);
+      return element;
+    }
+
+    Element LazyDocument::Value::decode() const {
+      // Primitives are read straight from their slice, without the state the parser keeps for containers.
+      Element element;
+      Cursor cursor(document->data, document->size);
+      cursor.pos = at(index);
+      cursor.end = at(index + 1);
+
+      String scratch;
+      ScalarBuilder builder(element);
+      parsePrimitive(cursor, builder, scratch);
+      expectValueEnd(cursor, document->data + document->size);
+      return element;
+    }
+
+    std::size_t LazyDocument::Value::next() const {
+      char in = *at(index);
+      if(in != '{' && in != '[') {
+        return index + 1;
+      }
+
+      // Brackets were matched by deserialize, so only the depth needs to be followed.
+      std::size_t position = index + 1;
+      for(std::size_t depth = 1; depth > 0; ++position) {
+        char structural = *at(position);
+        if(structural == '{' || structural == '[') ++depth;
+        else if(structural == '}' || structural == ']') --depth;
+      }
+      return position;
+    }
+
+    bool LazyDocument::Value::equals(const char *text, std::size_t size) const {
+      return view() == StringView(text, size);
+    }
+
+    LazyDocument::Array::const_iterator::const_iterator(const Value &value)
+      :value(value)
+    {
+      if(*value.at(value.index) != ']') {
+        value.check();
+      }
+    }
+
+    LazyDocument::Array::const_iterator &LazyDocument::Array::const_iterator::operator ++() {
+      std::size_t next = value.next();
+      char in = *value.at(next);
+      if(in == ',') {
+        // A closing bracket after the comma ends the array, as the parser allows trailing commas.
+        *this = const_iterator(Value(value.document, next + 1));
+      }
+      else if(in == ']') {
+        value = Value(value.document, next);
+      }
+      else {
+        value.fail("Expected ',' or closing bracket.", next);
+      }
+      return *this;
+    }
+
+    LazyDocument::Array::Array(const Value &start)
+      :start(start),last(start.next() - 1)
+    {}
+
+    LazyDocument::Array::const_iterator LazyDocument::Array::begin() const {
+      return const_iterator(Value(start.document, start.index + 1));
+    }
+
+    LazyDocument::Array::const_iterator LazyDocument::Array::end() const {
+      return const_iterator(Value(start.document, last));
+    }
+
+    LazyDocument::Value LazyDocument::Array::at(std::size_t index) const {
+      const_iterator it = begin(), last = end();
+      for(; it != last && index > 0; ++it, --index) {}
+      if(it == last) throw std::out_of_range("LazyDocument::Array::at");
+      return *it;
+    }
+
+    LazyDocument::Object::const_iterator::const_iterator(const Value &key)
+      :entry(key, key)
+    {
+      char in = *key.at(key.index);
+      if(in == '}') {
+        return;
+      }
+      if(in != '"') {
+        key.fail("Expected key or closing bracket.", key.index);
+      }
+      if(*key.at(key.index + 1) != ':') {
+        key.fail("Expected ':' separating key and value.", key.index + 1);
+      }
+      entry.second = Value(key.document, key.index + 2);
+      entry.second.check();
+    }
+
+    LazyDocument::Object::const_iterator &LazyDocument::Object::const_iterator::operator ++() {
+      const Value &value = entry.second;
+      std::size_t next = value.next();
+      char in = *value.at(next);
+      if(in == ',') {
+        // A closing bracket after the comma ends the object, as the parser allows trailing commas.
+        *this = const_iterator(Value(value.document, next + 1));
+      }
+      else if(in == '}') {
+        *this = const_iterator(Value(value.document, next));
+      }
+      else {
+        value.fail("Expected ',' or closing bracket.", next);
+      }
+      return *this;
+    }
+
+    LazyDocument::Object::Object(const Value &start)
+      :start(start),last(start.next() - 1)
+    {}
+
+    LazyDocument::Object::const_iterator LazyDocument::Object::begin() const {
+      return const_iterator(Value(start.document, start.index + 1));
+    }
+
+    LazyDocument::Object::const_iterator LazyDocument::Object::end() const {
+      return const_iterator(Value(start.document, last));
+    }
+
+    LazyDocument::Object::const_iterator LazyDocument::Object::find(const char *data, std::size_t size) const {
+      const_iterator it = begin(), last = end();
+      for(; it != last; ++it) {
+        if(it->first.equals(data, size)) {
+          break;
+        }
+      }
+      return it;
+    }
+
+    LazyDocument::Object::const_iterator LazyDocument::Object::find(const String &key) const {
+      return find(key.data(), key.size());
+    }
+
+    LazyDocument::Object::const_iterator LazyDocument::Object::find(const char *key) const {
+      return find(key, std::strlen(key));
+    }
+
+    LazyDocument::Value LazyDocument::Object::at(const String &key) const {
+      const_iterator it = find(key);
+      if(it == end()) throw std::out_of_range("LazyDocument::Object::at");
+      return it->second;
+    }
+
+    void parse(const char *data, std::size_t size, Handler &handler)
+    {
+      parse<Handler>(data, size, handler);
+    }
+
+    void parse(const String &str, Handler &handler)
+    {
+      parse<Handler>(str.data(), str.size(), handler);
+    }
+
+    namespace detail {
+      class ParserDriver {
+        // State of an incremental parser between two chunks.
+        // Calls into the handler go through one virtual call per chunk rather than per event.
+      public:
+        ParserDriver():line(1),previous('\0') {}
+        virtual ~ParserDriver() {}
+
+        virtual bool parse(Cursor &cursor) = 0;
+
+        ParseState state;
+
+        // Unread input from the previous chunk, starting with the token it cut off.
+        String pending;
+
+        // Line number of the first pending character and the character before it.
+        int line;
+        char previous;
+      };
+
+      template<class HandlerType>
+      class HandlerDriver: public ParserDriver {
+      public:
+        HandlerDriver(HandlerType handler):handler(handler) {}
+
+        bool parse(Cursor &cursor) {
+          return json::parse(cursor, state, handler);
+        }
+
+        HandlerType handler;
+      };
+    }
+
+    Parser::Parser(Handler &handler)
+      :driver(new detail::HandlerDriver<Handler&>(handler))
+    {}
+
+    Parser::Parser(Element &element)
+      :driver(new detail::HandlerDriver<DomBuilder>(DomBuilder(element)))
+    {}
+
+    Parser::~Parser() {
+      delete driver;
+    }
+
+    Parser::Status Parser::feed(const char *data, std::size_t size) {
+      // Tokens cut off at the end of the chunk are kept and completed by the next one.
+      // Otherwise the chunk is parsed in place without copying it.
+      String &pending = driver->pending;
+      bool buffered = !pending.empty();
+      if(buffered) {
+        pending.append(data, size);
+        data = pending.data();
+        size = pending.size();
+      }
+
+      Cursor cursor(data, size);
+      cursor.line = driver->line;
+      cursor.previous = driver->previous;
+      cursor.partial = true;
+
+      // While a string cut off by the last chunk is resumed, the index would go through it again.
+      bool complete;
+      if(worthIndexing(size) && driver->state.progress.quote < 0) {
+        detail::StructuralIndex index(data, size);
+        cursor.index = &index;
+        complete = driver->parse(cursor);
+      }
+      else {
+        complete = driver->parse(cursor);
+      }
+
+      driver->line += countLineBreaks(cursor.begin, cursor.pos);
+      if(cursor.pos > cursor.begin) {
+        driver->previous = cursor.pos[-1];
+      }
+      if(buffered) {
+        pending.erase(0, std::size_t(cursor.pos - cursor.begin));
+      }
+      else {
+        pending.assign(cursor.pos, cursor.end);
+      }
+
+      return complete ? COMPLETE : INCOMPLETE;
+    }
+
+    Parser::Status Parser::feed(const String &str) {
+      return feed(str.data(), str.size());
+    }
+
+    void Parser::finish() {
+      String &pending = driver->pending;
+      Cursor cursor(pending.data(), pending.size());
+      cursor.line = driver->line;
+      cursor.previous = driver->previous;
+      driver->parse(cursor);
+      pending.clear();
+    }
+
+    std::istream &feedStream(std::istream &stream, Parser &parser)
+    {
+      // Feed the stream to parser block by block, see STREAM_BLOCK_SIZE.
+      char block[STREAM_BLOCK_SIZE];
+      while(stream.read(block, sizeof(block)) || stream.gcount() > 0) {
+        parser.feed(block, std::size_t(stream.gcount()));
+      }
+      parser.finish();
+      return stream;
+    }
+
+    std::istream &parse(std::istream &stream, Handler &handler)
+    {
+      Parser parser(handler);
+      return feedStream(stream, parser);
+    }
+
+    void deserialize(const char *data, std::size_t size, Element &element)
+    {
+      DomBuilder builder(element);
+      parse(data, size, builder);
+    }
+
+    void deserialize(const char *data, std::size_t size, Element &element, const Projection &projection)
+    {
+      DomBuilder builder(element);
+      Projector projector(builder, projection);
+      parse(data, size, projector);
+    }
+
+    Element deserialize(const String &str, const Projection &projection)
+    {
+      Element el;
+      deserialize(str.data(), str.size(), el, projection);
+      return el;
+    }
+
+    void deserialize(const char *data, std::size_t size, Document &document)
+    {
+      document.clear();
+      DomBuilder builder(document.root(), document.allocator());
+      parse(data, size, builder);
+    }
+
+    void deserialize(const char *data, std::size_t size, Tape &tape)
+    {
+      // A partial tape has unterminated containers, so it is not left behind by a syntax error.
+      try {
+        TapeBuilder builder(tape, size);
+        parse(data, size, builder);
+      }
+      catch(...) {
+        tape.clear();
+        throw;
+      }
+    }
+
+    void validate(const String &str)
+    {
+      validate(str.data(), str.size());
+    }
+
+    void validate(const char *data, std::size_t size)
+    {
+      // The index and parser state are kept per thread, so their buffers are reused by later calls.
+      static thread_local detail::StructuralIndex index(data, 0);
+      static thread_local ParseState state;
+
+      Cursor cursor(data, size);
+      if(worthIndexing(size)) {
+        index.reset(data, size);
+        cursor.index = &index;
+      }
+      state.reset();
+
+      Validator validator;
+      parse(cursor, state, validator);
+    }
+
+    void deserialize(const char *data, std::size_t size, LazyDocument &document)
+    {
+      document.clear();
+      document.index(data, size);
+    }
+
+    void load(const char *path, LazyDocument &document)
+    {
+      document.clear();
+      document.file.open(path);
+      document.index(document.file.data, document.file.size);
+    }
+
+    Element deserialize(const char *data, std::size_t size)
+    {
+      Element el;
+      deserialize(data, size, el);
+      return el;
+    }
+
+    std::istream &deserialize(std::istream &stream, Element &element)
+    {
+      Parser parser(element);
+      return feedStream(stream, parser);
+    }
+
+    namespace detail {
+      class ReaderState {
+        // Input and parser state of a Reader between two documents.
+      public:
+        ReaderState(std::istream *stream, const char *data, std::size_t size)
+          :stream(stream),data(data),size(size),offset(0),index(nullptr),line(1),previous('\0')
+        {
+          parseState.multiple = true;
+          buildIndex();
+        }
+
+        ~ReaderState() {
+          delete index;
+        }
+
+        void buildIndex() {
+          // While a string cut off by the last block is resumed, the index would go through it again.
+          delete index;
+          index = worthIndexing(size) && parseState.progress.quote < 0 ? new StructuralIndex(data, size) : nullptr;
+        }
+
+        void fill() {
+          // Replace the consumed input by the next block of the stream. Only the token cut off by the last
+          // block is kept, and a string kept over several blocks already starts the buffer, so it is neither
+          // moved nor read again.
+          buffer.erase(0, offset);
+          std::size_t kept = buffer.size();
+          buffer.resize(kept + STREAM_BLOCK_SIZE);
+          stream->read(&buffer[kept], std::streamsize(STREAM_BLOCK_SIZE));
+          buffer.resize(kept + std::size_t(stream->gcount()));
+          if(!*stream) {
+            stream = nullptr;
+          }
+
+          data = buffer.data();
+          size = buffer.size();
+          offset = 0;
+          buildIndex();
+        }
+
+        // Source of further input, or nullptr once it is exhausted or when reading from a buffer.
+        std::istream *stream;
+        String buffer;
+
+        // Input not parsed yet starts at data + offset.
+        const char *data;
+        std::size_t size;
+        std::size_t offset;
+        StructuralIndex *index;
+
+        // Line number at data + offset and the character before it.
+        int line;
+        char previous;
+
+        ParseState parseState;
+      };
+    }
+
+    Cursor readerCursor(const detail::ReaderState &reader) {
+      // Cursor over the input of reader which has not been parsed yet.
+      Cursor cursor(reader.data + reader.offset, reader.size - reader.offset);
+      cursor.index = reader.index;
+      cursor.line = reader.line;
+      cursor.previous = reader.previous;
+      cursor.partial = reader.stream != nullptr;
+      return cursor;
+    }
+
+    void advance(detail::ReaderState &reader, const Cursor &cursor) {
+      // Mark the input up to the cursor's position as parsed.
+      reader.line += countLineBreaks(cursor.begin, cursor.pos);
+      if(cursor.pos > cursor.begin) {
+        reader.previous = cursor.pos[-1];
+      }
+      reader.offset += std::size_t(cursor.pos - cursor.begin);
+    }
+
+    template<class HandlerType>
+    bool readDocument(detail::ReaderState &reader, HandlerType &handler) {
+      // Report the next document to handler, or return false if only whitespace and comments are left.
+      reader.parseState.reset();
+
+      while(true) {
+        Cursor cursor = readerCursor(reader);
+        bool complete = parse(cursor, reader.parseState, handler);
+        advance(reader, cursor);
+
+        if(complete) {
+          return true;
+        }
+        if(!cursor.partial) {
+          return false;
+        }
+        reader.fill();
+      }
+    }
+
+    Reader::Reader(std::istream &stream)
+      :state(new detail::ReaderState(&stream, nullptr, 0))
+    {}
+
+    Reader::Reader(const char *data, std::size_t size)
+      :state(new detail::ReaderState(nullptr, data, size))
+    {}
+
+    Reader::~Reader() {
+      delete state;
+    }
+
+    bool Reader::next(Element &element) {
+      DomBuilder builder(element);
+      return readDocument(*state, builder);
+    }
+
+    bool Reader::next(Handler &handler) {
+      return readDocument(*state, handler);
+    }
+
+    struct Arrived {
+      // Thrown by Navigator once the parser has entered the array it was looking for.
+    };
+
+    class Navigator {
+      // Handler following a document to the array at a JSON Pointer, and ignoring everything on the way.
+      // Values off the path are still parsed rather than skipped, so a stream never has to hold one whole.
+    public:
+      explicit Navigator(const std::vector<String> &tokens)
+        :tokens(tokens),depth(0),onPath(false),keyMatches(false) {}
+
+      bool select(char in) {
+        // Whether the value about to be read lies on the path, which at the end of the path must be an array.
+        // Called again for the same value if it is cut off by the end of a block, so the index only moves
+        // on once the value is complete.
+        onPath = depth == 0;
+        if(depth && indices.size() == depth) {
+          std::size_t index = indices.back();
+          onPath = index == OBJECT ? keyMatches : isIndex(tokens[depth - 1], index);
+        }
+        if(onPath && depth == tokens.size() && in != '[') {
+          throw TypeError(Element::ARRAY);
+        }
+        return true;
+      }
+
+      void onNull() { complete(); }
+      void onBoolean(Boolean) { complete(); }
+      void onNumber(Number) { complete(); }
+      void onInteger(Integer) { complete(); }
+      void onUnsignedInteger(UnsignedInteger) { complete(); }
+      void onString() { complete(); }
+
+      void onKey(String &key) {
+        keyMatches = depth && indices.size() == depth && key == tokens[depth - 1];
+      }
+
+      void onStartObject() { start(OBJECT); }
+      void onStartArray() {
+        if(onPath && depth == tokens.size()) {
+          throw Arrived();
+        }
+        start(0);
+      }
+      void onEndObject() { end(); }
+      void onEndArray() { end(); }
+
+    private:
+      // Marks an object in indices.
+      static const std::size_t OBJECT = std::size_t(-1);
+
+      static bool isIndex(const String &token, std::size_t index) {
+        char digits[24];
+        char *first = digits + sizeof(digits);
+        do {
+          *--first = char('0' + index % 10);
+          index /= 10;
+        } while(index);
+        std::size_t size = std::size_t(digits + sizeof(digits) - first);
+        return token.size() == size && token.compare(0, size, first, size) == 0;
+      }
+
+      void start(std::size_t index) {
+        if(onPath) {
+          indices.push_back(index);
+        }
+        ++depth;
+      }
+
+      void end() {
+        // Once a container on the path is closed, no later value can be on it.
+        if(indices.size() == depth) {
+          throw std::out_of_range("ArrayReader: No value at path.");
+        }
+        --depth;
+        complete();
+      }
+
+      void complete() {
+        // Move past a value which has been read entirely.
+        if(depth && indices.size() == depth && indices.back() != OBJECT) {
+          ++indices.back();
+        }
+      }
+
+      const std::vector<String> &tokens;
+
+      // Open containers, and the next index of those on the path, or OBJECT. While the innermost
+      // container is on the path, there is one index per container.
+      std::size_t depth;
+      std::vector<std::size_t> indices;
+
+      bool onPath;
+      bool keyMatches;
+    };
+
+    bool selectValue(Navigator &navigator, char in) {
+      return navigator.select(in);
+    }
+
+    void parseStringValue(Cursor &cursor, Navigator &navigator, String &scratch) {
+      skipString(cursor, scratch);
+      navigator.onString();
+    }
+
+    namespace detail {
+      class ArrayReaderState {
+        // Input of an ArrayReader, and how far it has got through the array.
+      public:
+        ArrayReaderState(std::istream *stream, const char *data, std::size_t size, const String &path)
+          :reader(stream, data, size),tokens(splitPointer(path)),found(false),separator(false),done(false) {}
+
+        ReaderState reader;
+        std::vector<String> tokens;
+
+        bool found;      // Set once the input is inside the array.
+        bool separator;  // Set if an element has been read, so a comma must come first.
+        bool done;
+      };
+    }
+
+    void findArray(detail::ArrayReaderState &state) {
+      // Read up to and including the opening bracket of the array at the path.
+      detail::ReaderState &reader = state.reader;
+      Navigator navigator(state.tokens);
+      reader.parseState.reset();
+
+      while(true) {
+        Cursor cursor = readerCursor(reader);
+        bool complete;
+        try {
+          complete = parse(cursor, reader.parseState, navigator);
+        }
+        catch(Arrived &) {
+          advance(reader, cursor);
+          return;
+        }
+        advance(reader, cursor);
+
+        if(complete) {
+          throw std::out_of_range("ArrayReader: No value at path.");
+        }
+        if(!cursor.partial) {
+          throwSyntaxError(cursor, "Unexpected end of file.", cursor.end);
+        }
+        reader.fill();
+      }
+    }
+
+    template<class HandlerType>
+    bool readElement(detail::ArrayReaderState &state, HandlerType &handler) {
+      // Report the next element of the array to handler, or return false at its end.
+      if(!state.found) {
+        findArray(state);
+        state.found = true;
+      }
+
+      detail::ReaderState &reader = state.reader;
+      while(!state.done) {
+        Cursor cursor = readerCursor(reader);
+        try {
+          skipWhitespace(cursor);
+          if(cursor.pos == cursor.end && cursor.partial) {
+            throw Incomplete();
+          }
+        }
+        catch(Incomplete &) {
+          reader.fill();
+          continue;
+        }
+        if(cursor.pos == cursor.end) {
+          throwSyntaxError(cursor, "Unexpected end of file.", cursor.end);
+        }
+
+        char in = *cursor.pos;
+        if(in == ']') {
+          ++cursor.pos;
+          state.done = true;
+        }
+        else if(state.separator) {
+          if(in != ',') {
+            throwSyntaxError(cursor, "Expected ',' or closing bracket.", cursor.pos);
+          }
+          ++cursor.pos;
+          state.separator = false;
+        }
+        else {
+          advance(reader, cursor);
+          readDocument(reader, handler);
+          state.separator = true;
+          return true;
+        }
+        advance(reader, cursor);
+      }
+      return false;
+    }
+
+    ArrayReader::ArrayReader(std::istream &stream, const String &path)
+      :state(new detail::ArrayReaderState(&stream, nullptr, 0, path))
+    {}
+
+    ArrayReader::ArrayReader(const char *data, std::size_t size, const String &path)
+      :state(new detail::ArrayReaderState(nullptr, data, size, path))
+    {}
+
+    ArrayReader::~ArrayReader() {
+      delete state;
+    }
+
+    bool ArrayReader::next(Element &element) {
+      DomBuilder builder(element);
+      return readElement(*state, builder);
+    }
+
+    bool ArrayReader::next(Handler &handler) {
+      return readElement(*state, handler);
+    }
+
+    std::vector<const char *> splitLines(const char *data, std::size_t size, unsigned threads) {
+      // Split the input into ranges of similar size, one per thread, each starting at the beginning of a line.
+      // Returns the bounds of the ranges, i.e. one more than their number.
+      if(!threads) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+      }
+
+      // Smaller ranges are not worth starting a thread for.
+      static const std::size_t MIN_RANGE_SIZE = 65536;
+      std::size_t count = std::min(std::size_t(threads), size / MIN_RANGE_SIZE + 1);
+
+      const char *end = data + size;
+      std::vector<const char *> bounds;
+      bounds.push_back(data);
+
+      for(std::size_t i = 1; i < count; ++i) {
+        const char *split = std::max(data + size / count * i, bounds.back());
+        const void *newline = std::memchr(split, '\n', std::size_t(end - split));
+        if(!newline) {
+          break;
+        }
+        split = static_cast<const char *>(newline) + 1;
+        if(split > bounds.back() && split < end) {
+          bounds.push_back(split);
+        }
+      }
+
+      bounds.push_back(end);
+      return bounds;
+    }
+
+    template<class RangeReader>
+    void readLinesParallel(const char *data, const std::vector<const char *> &bounds, RangeReader &readRange)
+    {
+      // Calls readRange(i, reader) until it returns false for each range of lines, each range on its own
+      // thread. Rethrows the first error in input order once all threads are done.
+
+      std::size_t count = bounds.size() - 1;
+
+      std::vector<std::exception_ptr> errors(count);
+
+      // Ranges after the first failed one stop early, as their results are discarded anyway.
+      std::atomic<std::size_t> firstFailed(count);
+
+      auto work = [&](std::size_t i) {
+        try {
+          detail::ReaderState reader(nullptr, bounds[i], std::size_t(bounds[i + 1] - bounds[i]));
+          if(i > 0) {
+            reader.previous = bounds[i][-1];
+          }
+          while(firstFailed.load() > i && readRange(i, reader)) {}
+        }
+        catch(SyntaxError &e) {
+          // Line numbers are counted from the start of the range so far.
+          e.line += countLineBreaks(data, bounds[i]);
+          errors[i] = std::current_exception();
+        }
+        catch(...) {
+          errors[i] = std::current_exception();
+        }
+
+        if(errors[i]) {
+          std::size_t failed = firstFailed.load();
+          while(i < failed && !firstFailed.compare_exchange_weak(failed, i)) {}
+        }
+      };
+
+      // The calling thread reads the first range itself.
+      std::vector<std::thread> workers;
+      for(std::size_t i = 1; i < count; ++i) {
+        workers.push_back(std::thread(work, i));
+      }
+      work(0);
+      for(std::size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+      }
+
+      for(std::size_t i = 0; i < count; ++i) {
+        if(errors[i]) {
+          std::rethrow_exception(errors[i]);
+        }
+      }
+    }
+
+    Array deserializeLines(const char *data, std::size_t size, unsigned threads)
+    {
+      // Documents of each range, joined in order at the end.
+      std::vector<Array> ranges;
+
+      auto readRange = [&](std::size_t i, detail::ReaderState &reader) {
+        Array &documents = ranges[i];
+        documents.push_back(Element());
+        DomBuilder builder(documents.back());
+        if(!readDocument(reader, builder)) {
+          documents.pop_back();
+          return false;
+        }
+        return true;
+      };
+
+      std::vector<const char *> bounds = splitLines(data, size, threads);
+      ranges.resize(bounds.size() - 1);
+      readLinesParallel(data, bounds, readRange);
+
+      Array documents;
+      std::size_t total = 0;
+      for(std::size_t i = 0; i < ranges.size(); ++i) {
+        total += ranges[i].size();
+      }
+      documents.reserve(total);
+      for(std::size_t i = 0; i < ranges.size(); ++i) {
+        std::move(ranges[i].begin(), ranges[i].end(), std::back_inserter(documents));
+      }
+      return documents;
+    }
+
+    void deserializeLines(const char *data, std::size_t size, const std::function<void(Element &document)> &callback,
+                          unsigned threads)
+    {
+      auto readRange = [&](std::size_t, detail::ReaderState &reader) {
+        Element document;
+        DomBuilder builder(document);
+        if(!readDocument(reader, builder)) {
+          return false;
+        }
+        callback(document);
+        return true;
+      };
+
+      readLinesParallel(data, splitLines(data, size, threads), readRange);
+    }
+
+    Element deserialize(const String &str)
+    {
+      return deserialize(str.data(), str.size());
+    }
+
+    class StringOutput {
+      // Serializer output appended to a string.
+    public:
+      StringOutput(String &str):str(str) {}
+
+      void write(const char *data, std::size_t size) { str.append(data, size); }
+      void put(char c) { str.push_back(c); }
+
+    private:
+      String &str;
+    };
+
+    class FixedOutput {
+      // Serializer output to a fixed buffer. Output beyond its end is only counted.
+    public:
+      FixedOutput(char *buffer, std::size_t size):pos(buffer),end(buffer + size),total(0) {}
+
+      void write(const char *data, std::size_t size) {
+        std::size_t room = std::size_t(end - pos);
+        std::size_t count = size < room ? size : room;
+        std::memcpy(pos, data, count);
+        pos += count;
+        total += size;
+      }
+
+      void put(char c) {
+        if(pos < end) *pos++ = c;
+        ++total;
+      }
+
+      std::size_t size() const { return total; }
+
+    private:
+      char *pos;
+      char *end;
+      std::size_t total;
+    };
+
+    class StreamOutput {
+      // Serializer output to a stream, collected in blocks so the stream sees few large writes.
+    public:
+      StreamOutput(std::ostream &stream):stream(stream),used(0) {}
+      ~StreamOutput() { flush(); }
+
+      void write(const char *data, std::size_t size) {
+        if(size > sizeof(block) - used) {
+          flush();
+          if(size >= sizeof(block)) {
+            stream.write(data, std::streamsize(size));
+            return;
+          }
+        }
+        std::memcpy(block + used, data, size);
+        used += size;
+      }
+
+      void put(char c) {
+        if(used == sizeof(block)) flush();
+        block[used++] = c;
+      }
+
+      void flush() {
+        stream.write(block, std::streamsize(used));
+        used = 0;
+      }
+
+    private:
+      std::ostream &stream;
+      char block[16384];
+      std::size_t used;
+    };
+
+    template<class Output>
+    void writeIndent(Output &out, int indent) {
+      // Indentation is copied from a shared run of spaces rather than built per node.
+      static const char SPACES[] = "                                                                ";
+      static const int RUN = int(sizeof(SPACES) - 1);
+      for(; indent > RUN; indent -= RUN) {
+        out.write(SPACES, std::size_t(RUN));
+      }
+      if(indent > 0) {
+        out.write(SPACES, std::size_t(indent));
+      }
+    }
+
+    template<class Output>
+    void writeCodeEscape(Output &out, std::uint32_t code) {
+      static const char HEX[] = "0123456789abcdef";
+      char escape[6] = {'\\', 'u', HEX[(code >> 12) & 0xf], HEX[(code >> 8) & 0xf], HEX[(code >> 4) & 0xf], HEX[code & 0xf]};
+      out.write(escape, sizeof(escape));
+    }
+
+    template<class Output>
+    void serializeString(Output &out, const String &str, bool ascii) {
+      // Runs of characters which need no escaping, including valid UTF-8 unless ascii is set, are copied
+      // in one go. Bytes which are not part of valid UTF-8 are taken as Latin-1.
+
+      out.put('"');
+      const char *pos = str.data();
+      const char *end = pos + str.size();
+      while(pos < end) {
+        const char *run = pos;
+        std::uint32_t code = 0;
+        std::size_t length = 0;
+        while(true) {
+          pos = detail::findEscapeSpecial(pos, end);
+          if(pos == end || static_cast<unsigned char>(*pos) < 0x80) {
+            break;
+          }
+          length = detail::decodeUtf8(pos, end, code);
+          if(!length || ascii) {
+            break;
+          }
+          pos += length;
+        }
+        out.write(run, std::size_t(pos - run));
+        if(pos == end) {
+          break;
+        }
+
+        char c = *pos;
+        if(c == '\\') out.write("\\\\", 2);
+        else if(c == '"') out.write("\\\"", 2);
+        else if(c == '\n') out.write("\\n", 2);
+        else if(c == '\r') out.write("\\r", 2);
+        else if(c == '\t') out.write("\\t", 2);
+        else if(c == '\f') out.write("\\f", 2);
+        else if(c == '\b') out.write("\\b", 2);
+        else if(length > 1) {
+          // A valid multi-byte character in ascii mode, as one escape or a surrogate pair.
+          if(code >= 0x10000) {
+            code -= 0x10000;
+            writeCodeEscape(out, 0xd800 + (code >> 10));
+            writeCodeEscape(out, 0xdc00 + (code & 0x3ff));
+          }
+          else {
+            writeCodeEscape(out, code);
+          }
+          pos += length;
+          continue;
+        }
+        else {
+          // Control characters and stray bytes.
+          writeCodeEscape(out, static_cast<unsigned char>(c));
+        }
+        ++pos;
+      }
+      out.put('"');
+    }
+
+    template<class Output>
+    void serialize(Output &out, const Element &node, int indent, bool ascii)
+    {
+      // Compact output is requested by a negative indent.
+      bool compact = indent < 0;
+      int nextIndent = compact ? 0 : indent + 2;
 
       if(node.getType() == Element::NULL_VALUE) {
-        stream << "null";
+        out.write("null", 4);
       }
       else if(node.getType() == Element::BOOLEAN) {
-        stream << (node.boolean() ? "true" : "false");
+        if(node.boolean()) out.write("true", 4);
+        else out.write("false", 5);
       }
       else if(node.getType() == Element::STRING) {
-        serializeString(stream, node);
+        serializeString(out, node.str(), ascii);
       }
       else if(node.getType() == Element::NUMBER) {
-        const Number &num = node.number();
-        if(std::isfinite(num)) stream << num;
-        else stream << "null";
+        if(node.isInteger() || std::isfinite(node.number())) {
+          char buffer[detail::NUMBER_BUFFER_SIZE];
+          out.write(buffer, formatNumber(node, buffer));
+        }
+        else out.write("null", 4);
       }
       else if(node.getType() == Element::OBJECT) {
-	if(node.object().empty()) {
-	  stream << "{}";
-	}
-	else {
-	  stream << '{';
-
-	  if(compact) stream << ' ';
-	  else stream << std::endl;
-
-	  for(Object::const_iterator child = node.object().begin(); child != node.object().end(); ++child) {
-	    stream << nextIndent << '"' << child->first << "\": ";
+        const Object &object = node.object();
+        if(object.empty()) {
+          out.write("{}", 2);
+        }
+        else {
+          out.put('{');
+          out.put(compact ? ' ' : '\n');
 
-	    serialize(stream, child->second, compact ? -2 : indent + 2);
+          Object::const_iterator last = --object.end();
+          for(Object::const_iterator child = object.begin(); child != object.end(); ++child) {
+            writeIndent(out, nextIndent);
+            serializeString(out, child->first, ascii);
+            out.write(": ", 2);
 
-	    if(child->first != node.object().rbegin()->first) {
-	      stream << ',';
-	    }
+            serialize(out, child->second, compact ? -2 : nextIndent, ascii);
 
-	    if(compact) stream << ' ';
-	    else stream << std::endl;
-	  }
+            if(child != last) {
+              out.put(',');
+            }
+            out.put(compact ? ' ' : '\n');
+          }
 
-	  stream << thisIndent << '}';
-	}
+          writeIndent(out, compact ? 0 : indent);
+          out.put('}');
+        }
       }
       else if(node.getType() == Element::ARRAY) {
-	if(node.array().empty()) {
-	  stream << "[]";
-	}
-	else {
-	  stream << '[';
-
-          if(compact) stream << ' ';
-          else stream << std::endl;
-
-	  for(Array::const_iterator child = node.array().begin(); child != node.array().end(); ++child) {
-            if(!compact) {
-              stream << nextIndent;
-            }
+        const Array &array = node.array();
+        if(array.empty()) {
+          out.write("[]", 2);
+        }
+        else {
+          out.put('[');
+          out.put(compact ? ' ' : '\n');
 
-	    serialize(stream, *child, compact ? -2 : indent + 2);
+          for(Array::const_iterator child = array.begin(); child != array.end(); ++child) {
+            writeIndent(out, nextIndent);
 
-	    if(&*child != &*(node.array().rbegin())) {
-	      stream << ',';
-	    }
+            serialize(out, *child, compact ? -2 : nextIndent, ascii);
 
-            if(compact) stream << ' ';
-            else stream << std::endl;
-	  }
+            if(child + 1 != array.end()) {
+              out.put(',');
+            }
+            out.put(compact ? ' ' : '\n');
+          }
 
-          if(!compact)  stream << thisIndent;
-          stream << ']';
-	}
+          writeIndent(out, compact ? 0 : indent);
+          out.put(']');
+        }
       }
+    }
 
-      if(indent == 0 || indent == -1) {
-        stream << std::flush;
-      }
+    template<class Output>
+    void serialize(Output &out, const Element &node, unsigned options)
+    {
+      serialize(out, node, (options & INDENT) ? 0 : -1, (options & ASCII) != 0);
+    }
 
+    std::ostream &serialize(std::ostream &stream, const Element &node, unsigned options)
+    {
+      StreamOutput out(stream);
+      serialize(out, node, options);
       return stream;
     }
 
-    std::ostream &serialize(std::ostream &stream, const Element &node, bool indent)
+    void serialize(String &str, const Element &node, unsigned options)
+    {
+      StringOutput out(str);
+      serialize(out, node, options);
+    }
+
+    std::size_t serialize(char *buffer, std::size_t size, const Element &node, unsigned options)
     {
-      return serialize(stream, node, indent ? 0 : -1);
+      FixedOutput out(buffer, size);
+      serialize(out, node, options);
+      return out.size();
+    }
+
+    String serialize(const Element &node, unsigned options) {
+      String str;
+      serialize(str, node, options);
+      return str;
+    }
+
+    Writer::Writer(std::ostream &stream)
+      :stream(stream)
+    {}
+
+    Writer::~Writer() {
+      flush();
+    }
+
+    void Writer::write(const Element &element) {
+      // Documents are collected and passed on to the stream in large blocks.
+      static const std::size_t BLOCK_SIZE = 65536;
+
+      StringOutput out(buffer);
+      serialize(out, element, -1, false);
+      out.put('\n');
+
+      if(buffer.size() >= BLOCK_SIZE) {
+        stream.write(buffer.data(), std::streamsize(buffer.size()));
+        buffer.clear();
+      }
     }
 
-    String serialize(const Element &node, bool indent) {
-      std::ostringstream os;
-      serialize(os, node, indent ? 0 : -1);
-      return os.str();
+    void Writer::flush() {
+      stream.write(buffer.data(), std::streamsize(buffer.size()));
+      buffer.clear();
+      stream.flush();
     }
 
   }
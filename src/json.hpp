@@ -25,44 +25,285 @@ SOFTWARE.
 #define XYZDEV_JSON_HPP
 
 #include <vector>
-#include <map>
 #include <string>
+#include <utility>
 #include <exception>
+#include <iosfwd>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <atomic>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <initializer_list>
+#include <unordered_map>
 
 namespace xyz {
   namespace json {
 
     class Element;
+    class Object;
+
+    namespace detail {
+      class Arena {
+        // Monotonic allocator: memory is handed out from large blocks and only released all at once.
+      public:
+        explicit Arena(std::size_t blockSize);
+        Arena(const Arena &) = delete;
+        Arena &operator =(const Arena &) = delete;
+        ~Arena();
+
+        void *allocate(std::size_t size, std::size_t alignment) {
+          std::size_t offset = (used + alignment - 1) & ~(alignment - 1);
+          if(offset + size > capacity) {
+            return allocateBlock(size, alignment);
+          }
+          used = offset + size;
+          return block + offset;
+        }
+
+        // Make all memory available again, keeping the blocks for reuse.
+        void reset();
+
+      private:
+        void *allocateBlock(std::size_t size, std::size_t alignment);
+
+        std::size_t blockSize;
+        std::vector<std::pair<char *, std::size_t>> blocks;
+        std::size_t current;  // Index of block in blocks.
+        char *block;
+        std::size_t used;
+        std::size_t capacity;
+      };
+
+      class MappedFile {
+        // Read-only contents of a whole file, mapped into memory where the platform supports it and read
+        // into a heap buffer otherwise.
+      public:
+        MappedFile():data(nullptr),size(0),mapped(false) {}
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator =(const MappedFile &) = delete;
+        ~MappedFile() { close(); }
+
+        // Replace the contents with the file at path. Throws std::system_error if it cannot be read.
+        void open(const char *path);
+        void close();
+
+        const char *data;
+        std::size_t size;
+
+      private:
+        bool mapped;
+      };
+    }
+
+    namespace detail {
+      template<typename T>
+      struct Box {
+        // Reference counted payload of an Element, shared by copies until one of them is changed.
+        // A box which has handed out a mutable reference is no longer shared, since the reference
+        // could otherwise change all copies at once.
+        template<typename ... Args>
+        explicit Box(Args &&... args):references(1),shareable(true),value(std::forward<Args>(args)...) {}
+
+        std::atomic<unsigned> references;
+        bool shareable;
+        T value;
+      };
+    }
+
+    template<typename T>
+    class Allocator {
+      // Allocates from the arena of a Document, or from the heap if there is none. Memory from an arena
+      // is never freed individually. Copies of a container are allocated on the heap, so they may outlive
+      // the document.
+    public:
+      typedef T value_type;
+      typedef std::false_type propagate_on_container_copy_assignment;
+      typedef std::true_type propagate_on_container_move_assignment;
+      typedef std::true_type propagate_on_container_swap;
+
+      Allocator():arena(nullptr) {}
+      explicit Allocator(detail::Arena *arena):arena(arena) {}
+      template<typename U> Allocator(const Allocator<U> &r):arena(r.arena) {}
+
+      T *allocate(std::size_t count) {
+        if(arena) {
+          return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T)));
+        }
+        return static_cast<T *>(::operator new(count * sizeof(T)));
+      }
+
+      void deallocate(T *pointer, std::size_t) {
+        if(!arena) {
+          ::operator delete(pointer);
+        }
+      }
+
+      Allocator select_on_container_copy_construction() const { return Allocator(); }
+
+      template<typename U> bool operator ==(const Allocator<U> &r) const { return arena == r.arena; }
+      template<typename U> bool operator !=(const Allocator<U> &r) const { return arena != r.arena; }
+
+      detail::Arena *arena;
+    };
 
     typedef std::string String;
-    typedef std::map<String, Element> Object;
-    typedef std::vector<Element> Array;
+    typedef std::vector<Element, Allocator<Element>> Array;
     typedef bool Boolean;
     typedef double Number;
+    typedef std::int64_t Integer;
+    typedef std::uint64_t UnsignedInteger;
+
+    namespace detail {
+      struct KeyNode {
+        // Shared text of a Key. Immortal nodes are never freed and skip reference counting.
+        KeyNode(String &&text, std::size_t hash, bool immortal)
+          :text(std::move(text)),hash(hash),references(1),immortal(immortal) {}
+
+        const String text;
+        const std::size_t hash;
+        std::atomic<unsigned> references;
+        const bool immortal;
+      };
+
+      std::size_t hashKey(const char *data, std::size_t size);
+      const String &emptyKey();
+    }
+
+    class Key {
+      // Immutable object key which shares its text between copies, so repeated keys are stored once.
+      // Keys are compared by address first and by hash before their text.
+    public:
+      Key():node(nullptr) {}
+      Key(const String &text);
+      Key(String &&text);
+      Key(const char *text);
+      Key(const Key &r):node(r.node) { retain(); }
+      Key(Key &&r) noexcept:node(r.node) { r.node = nullptr; }
+      ~Key() { release(); }
+
+      // Key for a name which stays in use for the life of the process, such as a field name from
+      // XYZ_REFLECT. All calls with the same name return the same key, which is never freed.
+      static Key intern(const char *name);
+
+      Key &operator =(const Key &r) {
+        Key tmp(r);
+        std::swap(node, tmp.node);
+        return *this;
+      }
+
+      Key &operator =(Key &&r) noexcept {
+        std::swap(node, r.node);
+        return *this;
+      }
+
+      const String &str() const { return node ? node->text : detail::emptyKey(); }
+      operator const String &() const { return str(); }
+      const char *c_str() const { return str().c_str(); }
+      std::size_t size() const { return str().size(); }
+      std::size_t hash() const { return node ? node->hash : detail::hashKey("", 0); }
+
+      bool equals(const char *data, std::size_t size, std::size_t hash) const {
+        const String &text = str();
+        return this->hash() == hash && text.size() == size &&
+               (text.data() == data || text.compare(0, size, data, size) == 0);
+      }
+
+      bool operator ==(const Key &r) const { return node == r.node || r.equals(str().data(), size(), hash()); }
+      bool operator !=(const Key &r) const { return !(*this == r); }
+      bool operator <(const Key &r) const { return str() < r.str(); }
+
+    private:
+      explicit Key(detail::KeyNode *node):node(node) { retain(); }
+
+      void retain() {
+        if(node && !node->immortal) {
+          node->references.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+
+      void release() {
+        if(node && !node->immortal && node->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          delete node;
+        }
+      }
+
+      detail::KeyNode *node;
+    };
+
+    class StringView {
+      // Characters of a string inside a parsed buffer, without a terminating zero. Only valid while the
+      // buffer is.
+    public:
+      StringView():ptr(nullptr),len(0) {}
+      StringView(const char *data, std::size_t size):ptr(data),len(size) {}
+
+      const char *data() const { return ptr; }
+      std::size_t size() const { return len; }
+      bool empty() const { return !len; }
+      String str() const { return String(ptr, len); }
+
+      bool operator ==(const StringView &r) const {
+        return len == r.len && (ptr == r.ptr || !len || !std::memcmp(ptr, r.ptr, len));
+      }
+      bool operator !=(const StringView &r) const { return !(*this == r); }
+      bool operator ==(const String &r) const { return *this == StringView(r.data(), r.size()); }
+      bool operator !=(const String &r) const { return !(*this == r); }
+      bool operator ==(const char *r) const { return *this == StringView(r, std::strlen(r)); }
+      bool operator !=(const char *r) const { return !(*this == r); }
+
+    private:
+      const char *ptr;
+      std::size_t len;
+    };
+
+    inline bool operator ==(const Key &key, const String &str) { return key.str() == str; }
+    inline bool operator ==(const String &str, const Key &key) { return key.str() == str; }
+    inline bool operator ==(const Key &key, const char *str) { return key.str() == str; }
+    inline bool operator ==(const char *str, const Key &key) { return key.str() == str; }
+    inline bool operator !=(const Key &key, const String &str) { return key.str() != str; }
+    inline bool operator !=(const String &str, const Key &key) { return key.str() != str; }
+    inline bool operator !=(const Key &key, const char *str) { return key.str() != str; }
+    inline bool operator !=(const char *str, const Key &key) { return key.str() != str; }
 
     class Element {
     public:
       enum Type { NULL_VALUE = 0, OBJECT, ARRAY, STRING, NUMBER, BOOLEAN };
 
-      Element():type(NULL_VALUE) {}
-      Element(const Element &r):type(NULL_VALUE) { *this = r; }
-      Element(Type type):type(type) {}
-      Element(const Object &object):type(OBJECT),_object(object) {}
-      Element(const Array &array):type(ARRAY),_array(array) {}
-      Element(bool boolean):type(BOOLEAN),_boolean(boolean) {}
-      Element(Number number):type(NUMBER),_number(number) {}
-      Element(const String &str):type(STRING),_string(str) {}
-      Element(const char *str):type(STRING),_string(str) {}
+      // Representation of a NUMBER. Integer literals are kept exactly rather than rounded to a double.
+      enum NumberType: unsigned char { FLOATING_POINT = 0, SIGNED_INTEGER, UNSIGNED_INTEGER };
+
+      Element():type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) {}
+      Element(const Element &r):type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) { *this = r; }
+      Element(Element &&r) noexcept:type(NULL_VALUE),numberType(FLOATING_POINT),inArena(false) { swap(r); }
+      Element(Type type);
+      Element(const Object &object);
+      Element(Object &&object);
+      Element(const Array &array);
+      Element(Array &&array);
+      Element(bool boolean):type(BOOLEAN),numberType(FLOATING_POINT),inArena(false) { _boolean = boolean; }
+      Element(Number number):type(NUMBER),numberType(FLOATING_POINT),inArena(false) { _number = number; }
+      Element(Integer integer):type(NUMBER),numberType(SIGNED_INTEGER),inArena(false) { _integer = integer; }
+      Element(UnsignedInteger integer):type(NUMBER),numberType(UNSIGNED_INTEGER),inArena(false) { _unsignedInteger = integer; }
+      Element(const String &str);
+      Element(String &&str);
+      Element(const char *str);
+
+      // Empty container or string, or a string, with storage from allocator, such as Document::allocator().
+      // Copies of such an element are allocated on the heap. Moving it out of its document is only safe
+      // while the document lives.
+      Element(Type type, const Allocator<char> &allocator);
+      Element(String &&str, const Allocator<char> &allocator);
+
+      ~Element() { release(); }
 
       Type getType() const;
       const char *getTypeName() const;
 
-      bool empty() const {
-        return isNull() ||
-               (isBoolean() && !boolean()) ||
-               (isNumber() && !number()) ||
-               (_object.empty() && _array.empty() && _string.empty());
-      }
+      bool empty() const;
 
       bool isPrimitive() const { return type != OBJECT && type != ARRAY; }
 
@@ -72,36 +313,535 @@ namespace xyz {
       bool isString() const { return type == STRING; }
       bool isNumber() const { return type == NUMBER; }
       bool isBoolean() const { return type == BOOLEAN; }
+      bool isInteger() const { return type == NUMBER && numberType != FLOATING_POINT; }
 
+      NumberType getNumberType() const;
+
+      // Mutable access gives the element its own copy of a shared container or string first.
+      // The container or string is then copied, rather than shared, by later copies of the element.
       Object &object();
       Array &array();
       String &str();
       Boolean &boolean();
+      // Converts an integer to floating point in place, since the reference must refer to a double.
       Number &number();
 
       const Object &object() const;
       const Array &array() const;
       const String &str() const;
       const Boolean &boolean() const;
-      const Number &number() const;
+      Number number() const;
+
+      // The number as an integer. Floating point values are truncated towards zero.
+      // Throws TypeError if the value is out of range for the type.
+      Integer integer() const;
+      UnsignedInteger unsignedInteger() const;
 
       String toString() const;
 
-      void swap(Element &r);
+      // Set an entry of an object, or append to an array. Unlike object() and array(), these keep the
+      // container shareable, as no reference to it is handed out.
+      void set(const Key &key, Element &&value);
+      void append(Element &&value);
+
+      void swap(Element &r) noexcept;
 
       Element &operator =(const Element &r);
+      Element &operator =(Element &&r) noexcept;
 
       bool operator ==(const Element &r) const;
 
     protected:
+      friend class DomBuilder;
+
+      // Frees the payload of a container or string. Leaves type and payload untouched.
+      // Shared payloads are freed by their last owner. Payloads in an arena are never shared, and
+      // their memory stays with the arena.
+      void release();
+
+      // Only the member selected by type is valid. Containers and strings are
+      // held in reference counted boxes, so any node costs a tag and a single word.
       Type type;
-      Object _object;
-      Array _array;
-      String _string;
-      Number _number;
-      Boolean _boolean;
+      NumberType numberType;
+      bool inArena;  // Set if the container or string was placed in an arena.
+      union {
+        detail::Box<Object> *_object;
+        detail::Box<Array> *_array;
+        detail::Box<String> *_string;
+        Number _number;
+        Integer _integer;
+        UnsignedInteger _unsignedInteger;
+        Boolean _boolean;
+      };
+    };
+
+    class Object {
+      // Map from keys to elements, stored as one vector of entries in insertion order. Small objects are
+      // searched linearly, larger ones through a hash index of the entries. Iteration, and so serialization,
+      // follows insertion order. Unlike std::map, erasing invalidates iterators and references to all
+      // entries, and inserting may do so.
+    public:
+      typedef Key key_type;
+      typedef Element mapped_type;
+      typedef std::pair<Key, Element> value_type;
+      typedef std::vector<value_type, Allocator<value_type>>::iterator iterator;
+      typedef std::vector<value_type, Allocator<value_type>>::const_iterator const_iterator;
+      typedef std::size_t size_type;
+
+      // Objects with at least this many entries are indexed.
+      static const size_type INDEX_THRESHOLD = 16;
+
+      Object() {}
+      explicit Object(const Allocator<char> &allocator):entries(allocator),index(allocator) {}
+
+      iterator begin() { return entries.begin(); }
+      iterator end() { return entries.end(); }
+      const_iterator begin() const { return entries.begin(); }
+      const_iterator end() const { return entries.end(); }
+
+      bool empty() const { return entries.empty(); }
+      size_type size() const { return entries.size(); }
+      void clear();
+      void reserve(size_type size) { entries.reserve(size); }
+
+      // Lookups by String or C string do not create a key.
+      iterator find(const Key &key);
+      iterator find(const String &key);
+      iterator find(const char *key);
+      const_iterator find(const Key &key) const;
+      const_iterator find(const String &key) const;
+      const_iterator find(const char *key) const;
+      size_type count(const String &key) const { return find(key) != end(); }
+
+      // Throw std::out_of_range if there is no entry for key.
+      Element &at(const String &key);
+      const Element &at(const String &key) const;
+
+      Element &operator [](const Key &key);
+      Element &operator [](Key &&key);
+      Element &operator [](const String &key);
+      Element &operator [](const char *key);
+
+      // Append entry unless its key is present. Returns the entry for the key, and whether it was added.
+      std::pair<iterator, bool> insert(const value_type &entry);
+      std::pair<iterator, bool> insert(value_type &&entry);
+
+      size_type erase(const String &key);
+      iterator erase(const_iterator pos);
+
+      void swap(Object &r) noexcept;
+
+      // Objects are equal if they have the same keys and values, in any order.
+      bool operator ==(const Object &r) const;
+      bool operator !=(const Object &r) const { return !(*this == r); }
+
+    private:
+      const_iterator find(const char *data, std::size_t size, std::size_t hash) const;
+      iterator append(value_type &&entry);
+      void addToIndex(std::size_t position);
+      void buildIndex();
+
+      std::vector<value_type, Allocator<value_type>> entries;
+
+      // Open addressing table of entry positions plus one, with 0 marking a free slot.
+      // Empty while there are fewer than INDEX_THRESHOLD entries.
+      std::vector<std::uint32_t, Allocator<std::uint32_t>> index;
+    };
+
+    class Document {
+      // Owns a tree whose containers, strings and element storage are allocated from one arena, which
+      // is released in one go. Elements are created in the arena by deserialize(..., Document &), by
+      // ReflectionSink(document.allocator()) and by the Element constructors taking an allocator.
+      // Strings longer than std::string's inline buffer keep their characters on the heap.
+    public:
+      explicit Document(std::size_t blockSize = 65536):arena(blockSize) {}
+      Document(const Document &) = delete;
+      Document &operator =(const Document &) = delete;
+
+      Element &root() { return tree; }
+      const Element &root() const { return tree; }
+
+      Allocator<char> allocator() { return Allocator<char>(&arena); }
+
+      // Destroy the tree and keep the arena's memory for the next one, e.g. once per frame.
+      void clear();
+
+    private:
+      // Declared first, so the tree is destroyed before the arena.
+      detail::Arena arena;
+      Element tree;
+    };
+
+    class Tape {
+      // Read-only document stored as one array of 64 bit words, with the characters of strings and keys
+      // in a second buffer. Parsing into a tape takes two growing allocations rather than one per node,
+      // and reading it walks memory in order. Filled by deserialize(..., Tape &), and reused by later calls.
+      //
+      // Each word holds a tag in its top byte and a 56 bit payload:
+      //   'n', 't', 'f'   null, true and false.
+      //   'd', 'l', 'u'   double, signed and unsigned integer, whose bits are in the following word.
+      //   '"'             string or key; the payload is the offset of its length in the string buffer,
+      //                   which is followed by the characters and a terminating zero.
+      //   '{', '['        start of a container; the payload holds the number of entries (upper 24 bits,
+      //                   saturated) and the position after the matching end word (lower 32 bits).
+      //   '}', ']'        end of a container; the payload is the position of the start word.
+      // Inside an object, each value is preceded by its key.
+    public:
+      class Value;
+      class Array;
+      class Object;
+
+      Tape();
+
+      // The root value, null if nothing has been parsed. Values refer into the tape and are invalidated
+      // by the next parse or clear().
+      Value root() const;
+
+      void clear();
+
+    private:
+      friend class TapeBuilder;
+
+      std::vector<std::uint64_t> words;
+      String strings;
+    };
+
+    class Tape::Value {
+      // Position of a value on a tape. Accessors mirror Element, and throw TypeError on a type mismatch.
+    public:
+      Value():tape(nullptr),position(0) {}
+
+      Element::Type getType() const;
+      const char *getTypeName() const;
+
+      bool isNull() const { return getType() == Element::NULL_VALUE; }
+      bool isObject() const { return getType() == Element::OBJECT; }
+      bool isArray() const { return getType() == Element::ARRAY; }
+      bool isString() const { return getType() == Element::STRING; }
+      bool isNumber() const { return getType() == Element::NUMBER; }
+      bool isBoolean() const { return getType() == Element::BOOLEAN; }
+      bool isInteger() const { return isNumber() && getNumberType() != Element::FLOATING_POINT; }
+
+      Element::NumberType getNumberType() const;
+
+      Object object() const;
+      Array array() const;
+      Boolean boolean() const;
+      Number number() const;
+      Integer integer() const;
+      UnsignedInteger unsignedInteger() const;
+
+      // Strings are copied by str(). c_str() and length() refer to the characters on the tape.
+      String str() const;
+      const char *c_str() const;
+      std::size_t length() const;
+
+      // Copy the value and everything below it into an element tree.
+      Element toElement() const;
+
+    private:
+      friend class Tape;
+
+      Value(const Tape *tape, std::size_t position):tape(tape),position(position) {}
+
+      // Position after the value and everything below it.
+      std::size_t next() const;
+
+      const Tape *tape;
+      std::size_t position;
+    };
+
+    class Tape::Array {
+      // Elements of an array on a tape. Indexing walks the array, so iterate where possible.
+    public:
+      class const_iterator {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Value value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Value *pointer;
+        typedef const Value &reference;
+
+        const Value &operator *() const { return value; }
+        const Value *operator ->() const { return &value; }
+        const_iterator &operator ++() { value = Value(value.tape, value.next()); return *this; }
+        const_iterator operator ++(int) { const_iterator it = *this; ++*this; return it; }
+        bool operator ==(const const_iterator &r) const { return value.position == r.value.position; }
+        bool operator !=(const const_iterator &r) const { return value.position != r.value.position; }
+
+      private:
+        friend class Array;
+        explicit const_iterator(const Value &value):value(value) {}
+        Value value;
+      };
+      typedef const_iterator iterator;
+
+      const_iterator begin() const;
+      const_iterator end() const;
+
+      bool empty() const { return begin() == end(); }
+      std::size_t size() const;
+
+      // Throws std::out_of_range if index is past the end.
+      Value at(std::size_t index) const;
+      Value operator [](std::size_t index) const { return at(index); }
+
+    private:
+      friend class Value;
+      explicit Array(const Value &start):start(start) {}
+      Value start;
+    };
+
+    class Tape::Object {
+      // Entries of an object on a tape, in document order. Lookups search linearly.
+    public:
+      typedef std::pair<Value, Value> value_type;
+
+      class const_iterator {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<Value, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type *pointer;
+        typedef const value_type &reference;
+
+        const value_type &operator *() const { return entry; }
+        const value_type *operator ->() const { return &entry; }
+        const_iterator &operator ++();
+        const_iterator operator ++(int) { const_iterator it = *this; ++*this; return it; }
+        bool operator ==(const const_iterator &r) const { return entry.first.position == r.entry.first.position; }
+        bool operator !=(const const_iterator &r) const { return entry.first.position != r.entry.first.position; }
+
+      private:
+        friend class Object;
+        explicit const_iterator(const Value &key);
+        value_type entry;
+      };
+      typedef const_iterator iterator;
+
+      const_iterator begin() const;
+      const_iterator end() const;
+
+      bool empty() const { return begin() == end(); }
+      std::size_t size() const;
+
+      const_iterator find(const String &key) const;
+      const_iterator find(const char *key) const;
+      std::size_t count(const String &key) const { return find(key) != end(); }
+
+      // Throws std::out_of_range if there is no entry for key.
+      Value at(const String &key) const;
+      Value operator [](const String &key) const { return at(key); }
+
+    private:
+      friend class Value;
+      explicit Object(const Value &start):start(start) {}
+      const_iterator find(const char *data, std::size_t size) const;
+      Value start;
+    };
+
+    class LazyDocument {
+      // Document parsed on demand. deserialize(..., LazyDocument &) only indexes the structural characters
+      // of the input and checks that brackets match. Values are decoded, and their syntax checked, when
+      // they are accessed, and anything not accessed is never decoded. Skipping a container walks its
+      // structural positions once, so prefer a single pass over repeated lookups in large objects.
+      // The input buffer must stay valid and unchanged while the document or its values are in use,
+      // unless it was read by load(), in which case the document keeps the file mapped until cleared.
+    public:
+      class Value;
+      class Array;
+      class Object;
+
+      LazyDocument();
+      LazyDocument(const LazyDocument &) = delete;
+      LazyDocument &operator =(const LazyDocument &) = delete;
+
+      // The root value, null if nothing has been parsed. Values, and string views taken from them, are
+      // invalidated by the next parse or clear().
+      Value root() const;
+
+      void clear();
+
+    private:
+      friend void deserialize(const char *data, std::size_t size, LazyDocument &document);
+      friend void load(const char *path, LazyDocument &document);
+
+      // Index data, which the document must have been cleared for.
+      void index(const char *data, std::size_t size);
+
+      detail::MappedFile file;
+      const char *data;
+      std::size_t size;
+
+      // Offsets of brackets, colons, commas, opening quotes and the first bytes of numbers and literals.
+      std::vector<std::uint32_t> positions;
+
+      // Strings with escapes which have been read, by index into positions. Each is decoded once and kept
+      // until the document is cleared.
+      mutable std::unordered_map<std::size_t, String> decoded;
+    };
+
+    class LazyDocument::Value {
+      // Position of a value in a lazy document. Accessors mirror Element, and throw TypeError on a type
+      // mismatch or SyntaxError if the value turns out to be malformed. Numbers and literals are decoded
+      // from the input on every access, strings without escapes are compared and viewed in place.
+    public:
+      Value():document(nullptr),index(0) {}
+
+      Element::Type getType() const;
+      const char *getTypeName() const;
+
+      bool isNull() const { return getType() == Element::NULL_VALUE; }
+      bool isObject() const { return getType() == Element::OBJECT; }
+      bool isArray() const { return getType() == Element::ARRAY; }
+      bool isString() const { return getType() == Element::STRING; }
+      bool isNumber() const { return getType() == Element::NUMBER; }
+      bool isBoolean() const { return getType() == Element::BOOLEAN; }
+
+      Object object() const;
+      Array array() const;
+      Boolean boolean() const;
+      Number number() const;
+      Integer integer() const;
+      UnsignedInteger unsignedInteger() const;
+      String str() const;
+
+      // The characters of a string or key without copying them. A string without escapes refers directly
+      // into the input, one with escapes is decoded into storage owned by the document the first time it
+      // is read. Either stays valid until the document is cleared or reused. Reading escaped strings
+      // modifies the document, so it must not be done on several threads at once.
+      StringView view() const;
+
+      // Decode the value and everything below it into an element tree.
+      Element toElement() const;
+
+    private:
+      friend class LazyDocument;
+
+      Value(const LazyDocument *document, std::size_t index):document(document),index(index) {}
+
+      // Input at the given index into positions, or the end of input past the last one.
+      const char *at(std::size_t position) const;
+      [[noreturn]] void fail(const char *msg, std::size_t position) const;
+
+      // Throw SyntaxError unless the value starts like one, rather than with a separator or closing bracket.
+      void check() const;
+
+      // Index of the first structural position after the value and everything below it.
+      std::size_t next() const;
+
+      // Compare a string value to the given text without decoding it, unless it contains escapes.
+      bool equals(const char *text, std::size_t size) const;
+
+      // Decode a primitive.
+      Element decode() const;
+
+      const LazyDocument *document;
+      std::size_t index;  // Index of the value's first position in positions.
+    };
+
+    class LazyDocument::Array {
+      // Elements of an array in a lazy document. Indexing walks the array, so iterate where possible.
+    public:
+      class const_iterator {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Value value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Value *pointer;
+        typedef const Value &reference;
+
+        const Value &operator *() const { return value; }
+        const Value *operator ->() const { return &value; }
+        const_iterator &operator ++();
+        const_iterator operator ++(int) { const_iterator it = *this; ++*this; return it; }
+        bool operator ==(const const_iterator &r) const { return value.index == r.value.index; }
+        bool operator !=(const const_iterator &r) const { return value.index != r.value.index; }
+
+      private:
+        friend class Array;
+        explicit const_iterator(const Value &value);
+        Value value;
+      };
+      typedef const_iterator iterator;
+
+      const_iterator begin() const;
+      const_iterator end() const;
+
+      bool empty() const { return begin() == end(); }
+      std::size_t size() const { return std::size_t(std::distance(begin(), end())); }
+
+      // Throws std::out_of_range if index is past the end.
+      Value at(std::size_t index) const;
+      Value operator [](std::size_t index) const { return at(index); }
+
+    private:
+      friend class Value;
+      explicit Array(const Value &start);
+      Value start;
+      std::size_t last;  // Index of the closing bracket, found once so that end() is cheap.
+    };
+
+    class LazyDocument::Object {
+      // Entries of an object in a lazy document, in document order. Lookups search linearly.
+    public:
+      typedef std::pair<Value, Value> value_type;
+
+      class const_iterator {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<Value, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type *pointer;
+        typedef const value_type &reference;
+
+        const value_type &operator *() const { return entry; }
+        const value_type *operator ->() const { return &entry; }
+        const_iterator &operator ++();
+        const_iterator operator ++(int) { const_iterator it = *this; ++*this; return it; }
+        bool operator ==(const const_iterator &r) const { return entry.first.index == r.entry.first.index; }
+        bool operator !=(const const_iterator &r) const { return entry.first.index != r.entry.first.index; }
+
+      private:
+        friend class Object;
+        explicit const_iterator(const Value &key);
+        value_type entry;
+      };
+      typedef const_iterator iterator;
+
+      const_iterator begin() const;
+      const_iterator end() const;
+
+      bool empty() const { return begin() == end(); }
+      std::size_t size() const { return std::size_t(std::distance(begin(), end())); }
+
+      const_iterator find(const String &key) const;
+      const_iterator find(const char *key) const;
+      std::size_t count(const String &key) const { return find(key) != end(); }
+
+      // Throws std::out_of_range if there is no entry for key.
+      Value at(const String &key) const;
+      Value operator [](const String &key) const { return at(key); }
+
+    private:
+      friend class Value;
+      explicit Object(const Value &start);
+      const_iterator find(const char *data, std::size_t size) const;
+      Value start;
+      std::size_t last;  // Index of the closing bracket.
     };
 
+    inline bool Element::empty() const {
+      switch(type) {
+        case OBJECT: return _object->value.empty();
+        case ARRAY: return _array->value.empty();
+        case STRING: return _string->value.empty();
+        case NUMBER: return numberType == FLOATING_POINT ? !_number : !_unsignedInteger;
+        case BOOLEAN: return !_boolean;
+        default: return true;
+      }
+    }
+
     class TypeError: public std::exception {
     public:
       TypeError()
@@ -153,11 +893,213 @@ namespace xyz {
         char chr;
     };
 
-    String serialize(const Element &node, bool indent = false);
-    std::ostream &serialize(std::ostream &stream, const Element &node, bool indent = false);
+    class Handler {
+      // Receives the events of a document while it is parsed, without building an element tree.
+      // Keys and values are only valid during the call. The default implementations ignore the event.
+    public:
+      virtual ~Handler() {}
+
+      virtual void onNull() {}
+      virtual void onBoolean(Boolean value) {}
+      virtual void onNumber(Number value) {}
+
+      // Integer literals without fraction or exponent, if they fit in 64 bits. Passed on to onNumber by default.
+      virtual void onInteger(Integer value) { onNumber(Number(value)); }
+      virtual void onUnsignedInteger(UnsignedInteger value) { onNumber(Number(value)); }
+      virtual void onString(const String &value) {}
+
+      // Inside an object, each value is preceded by its key.
+      virtual void onKey(const String &key) {}
+
+      virtual void onStartObject() {}
+      virtual void onEndObject() {}
+      virtual void onStartArray() {}
+      virtual void onEndArray() {}
+    };
+
+    class Projection {
+      // Set of JSON Pointer paths (RFC 6901) selecting the parts of a document that deserialize builds, such
+      // as "/entities/*/transform". A "*" token matches every key of an object and every index of an array.
+      // The empty path selects the whole document.
+    public:
+      Projection() {}
+      Projection(std::initializer_list<String> paths);
+
+      // Throws std::invalid_argument if path is not a valid JSON Pointer.
+      void add(const String &path);
+
+    private:
+      friend class Projector;
+
+      struct Node {
+        Node():wildcard(0),selected(false) {}
+
+        std::vector<std::pair<String, std::uint32_t>> children;
+        std::uint32_t wildcard;  // Child for "*", 0 if there is none as the root is nobody's child.
+        bool selected;           // A path ends here, so the whole value is built.
+      };
+
+      // Trie of path tokens, rooted at the first node.
+      std::vector<Node> nodes;
+    };
+
+    namespace detail {
+      class ParserDriver;
+      class ReaderState;
+      class ArrayReaderState;
+    }
+
+    class Parser {
+      // Incremental parser for input which arrives in chunks, e.g. from a pipe or while reading a large file.
+      // Events are reported as soon as their token is complete, so the whole input never needs to be buffered.
+    public:
+      enum Status { INCOMPLETE, COMPLETE };
+
+      // Report events to handler, or build the document in element.
+      Parser(Handler &handler);
+      Parser(Element &element);
+      Parser(const Parser &) = delete;
+      Parser &operator =(const Parser &) = delete;
+      ~Parser();
+
+      // Parse the next chunk of input. Returns COMPLETE once the root value has been read, though
+      // whitespace and comments may still follow. Throws SyntaxError on malformed input, after which
+      // the parser must not be used any more.
+      Status feed(const char *data, std::size_t size);
+      Status feed(const String &str);
+
+      // Signal the end of input. Throws SyntaxError if the document is incomplete.
+      void finish();
+
+    private:
+      detail::ParserDriver *driver;
+    };
+
+    class Reader {
+      // Reads a sequence of documents separated by whitespace, such as newline-delimited JSON (NDJSON).
+      // The parser state is kept from one document to the next.
+    public:
+      // Read from stream as needed, or from a buffer which must stay valid while the reader is in use.
+      Reader(std::istream &stream);
+      Reader(const char *data, std::size_t size);
+      Reader(const Reader &) = delete;
+      Reader &operator =(const Reader &) = delete;
+      ~Reader();
+
+      // Read the next document into element, or report it to handler. Returns false once only whitespace
+      // and comments are left. Throws SyntaxError on malformed input, with lines counted from the start.
+      bool next(Element &element);
+      bool next(Handler &handler);
+
+    private:
+      detail::ReaderState *state;
+    };
+
+    class ArrayReader {
+      // Pull reader over the elements of one array in a document, such as the records of a dump shaped like
+      // {"entities": [...]}. Elements are read one at a time, so memory is bounded by the largest element
+      // rather than the whole array. Input after the array is not read. To load a reflectable, read each
+      // element and pass it to core::ReflectionSource.
+    public:
+      // path is a JSON Pointer to the array, empty for the root. Read from stream as needed, or from a
+      // buffer which must stay valid while the reader is in use.
+      ArrayReader(std::istream &stream, const String &path = String());
+      ArrayReader(const char *data, std::size_t size, const String &path = String());
+      ArrayReader(const ArrayReader &) = delete;
+      ArrayReader &operator =(const ArrayReader &) = delete;
+      ~ArrayReader();
+
+      // Read the next element into element, or report it to handler. Returns false after the last one.
+      // The first call finds the array, and throws std::out_of_range if there is no value at path or
+      // TypeError if it is not an array. Throws SyntaxError on malformed input.
+      bool next(Element &element);
+      bool next(Handler &handler);
+
+    private:
+      detail::ArrayReaderState *state;
+    };
+
+    class Writer {
+      // Writes a sequence of documents as newline-delimited JSON, one compact document per line.
+      // Output is passed to the stream in large blocks, and only flushed by flush() and on destruction.
+    public:
+      Writer(std::ostream &stream);
+      Writer(const Writer &) = delete;
+      Writer &operator =(const Writer &) = delete;
+      ~Writer();
+
+      void write(const Element &element);
+      void flush();
+
+    private:
+      std::ostream &stream;
+      String buffer;
+    };
+
+    // Options for serialize, combined with '|'.
+    enum SerializeOption {
+      COMPACT = 0,  // Print on a single line.
+      INDENT = 1,   // Print over multiple lines, indented by nesting depth. Same as passing true.
+      ASCII = 2     // Escape all non-ASCII characters, using surrogate pairs above U+FFFF.
+    };
+
+    // Serialize a document. Valid UTF-8 is written as is unless ASCII is set, other bytes above 0x7e
+    // are escaped as Latin-1. Streams are written in large blocks and never flushed.
+    String serialize(const Element &node, unsigned options = COMPACT);
+    std::ostream &serialize(std::ostream &stream, const Element &node, unsigned options = COMPACT);
+
+    // Append the document to str.
+    void serialize(String &str, const Element &node, unsigned options = COMPACT);
+
+    // Write the document to a fixed buffer and return its full length. Only the first size characters
+    // are written if it is longer. The output is not terminated.
+    std::size_t serialize(char *buffer, std::size_t size, const Element &node, unsigned options = COMPACT);
 
     Element deserialize(const String &str);
+    Element deserialize(const char *data, std::size_t size);
+    void deserialize(const char *data, std::size_t size, Element &element);
+
+    // Build only the values selected by projection, and their parents. Objects keep the selected entries,
+    // arrays hold null in place of unselected elements so indices do not change. Everything else is
+    // skipped by matching brackets without being decoded, and is only checked for terminated strings
+    // and mismatched brackets.
+    Element deserialize(const String &str, const Projection &projection);
+    void deserialize(const char *data, std::size_t size, Element &element, const Projection &projection);
+
+    // Parse into the root of document, replacing its previous tree. Throws SyntaxError on malformed input.
+    void deserialize(const char *data, std::size_t size, Document &document);
+
+    // Parse into tape, replacing its previous contents. Throws SyntaxError on malformed input.
+    void deserialize(const char *data, std::size_t size, Tape &tape);
+
+    // Index data for access through document, see LazyDocument. Throws SyntaxError if brackets do not match
+    // or the input holds anything but one value. Other errors are only found when values are accessed.
+    void deserialize(const char *data, std::size_t size, LazyDocument &document);
+
+    // Map the file at path into memory and index it into document, which parses it in place. Throws
+    // std::system_error if the file cannot be read and SyntaxError like deserialize(..., LazyDocument &).
+    void load(const char *path, LazyDocument &document);
+
     std::istream &deserialize(std::istream &stream, Element &element);
+
+    // Parse newline-delimited JSON with one document per line, splitting the buffer between up to threads
+    // threads (0 for one per core). Documents are returned in input order, or passed to callback on the
+    // worker threads as they are read. The first syntax error in input order is rethrown once all threads
+    // are done; callback may have seen documents after it by then.
+    Array deserializeLines(const char *data, std::size_t size, unsigned threads = 0);
+    void deserializeLines(const char *data, std::size_t size, const std::function<void(Element &document)> &callback,
+                          unsigned threads = 0);
+
+    // Check that input is a single well-formed document, by the same rules as deserialize, without building
+    // it. Throws SyntaxError on malformed input. Buffers are reused between calls on the same thread, so
+    // this only allocates while they grow, and for numbers of 64 or more characters.
+    void validate(const String &str);
+    void validate(const char *data, std::size_t size);
+
+    // Parse a document and report it to handler as it is read. Errors are thrown as SyntaxError.
+    void parse(const String &str, Handler &handler);
+    void parse(const char *data, std::size_t size, Handler &handler);
+    std::istream &parse(std::istream &stream, Handler &handler);
   }
 }
 
@@ -0,0 +1,68 @@
+/*
+
+Copyright (c) 2016 xyzdev.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef XYZDEV_JSON_NUMBER_HPP
+#define XYZDEV_JSON_NUMBER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Number codec for the JSON parser and serializer.
+ * Parsing uses an exact fast path for short decimals and the Eisel-Lemire algorithm otherwise,
+ * formatting uses Grisu3 with an exact fallback. Both are locale independent and round-trip doubles exactly.
+ * Integers without fraction or exponent are handled separately, so that 64 bit values survive unchanged.
+ */
+
+namespace xyz {
+  namespace json {
+    namespace detail {
+
+      // Longest text written by formatNumber.
+      static const std::size_t NUMBER_BUFFER_SIZE = 32;
+
+      // Parses the number in [begin, end), which must be consumed entirely.
+      // Returns false if the text is malformed, has more than 19 significant digits, or its value
+      // overflows or underflows to zero. The caller is expected to fall back to strtod for these cases,
+      // which also decides how to report malformed input.
+      bool parseNumber(const char *begin, const char *end, double &value);
+
+      // Parses the integer in [begin, end), an optional sign followed by digits only, into its sign and magnitude.
+      // Returns false for any other text, for minus zero (which only a double represents) and for values
+      // below -2^63 or above 2^64 - 1. The caller then falls back to parseNumber.
+      bool parseInteger(const char *begin, const char *end, bool &negative, std::uint64_t &magnitude);
+
+      // Writes the shortest text which parses back to exactly value, which must be finite, taking the
+      // candidate closest to value where several are equally short.
+      // Returns the number of characters written to buffer, which needs room for NUMBER_BUFFER_SIZE.
+      std::size_t formatNumber(double value, char *buffer);
+
+      // Write the exact decimal digits of an integer, same buffer requirements as formatNumber.
+      std::size_t formatInteger(std::int64_t value, char *buffer);
+      std::size_t formatInteger(std::uint64_t value, char *buffer);
+
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,489 @@
+/*
+
+Copyright (c) 2016 xyzdev.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "json_scan.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XYZ_JSON_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XYZ_JSON_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define XYZ_JSON_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define XYZ_JSON_FORCE_INLINE __forceinline
+#else
+#define XYZ_JSON_FORCE_INLINE inline
+#endif
+
+namespace xyz {
+  namespace json {
+    namespace detail {
+
+      XYZ_JSON_FORCE_INLINE unsigned lowestBit(std::uint64_t mask) {
+#if defined(__GNUC__)
+        return unsigned(__builtin_ctzll(mask));
+#else
+        unsigned i = 0;
+        while(!(mask & 1)) {
+          mask >>= 1;
+          ++i;
+        }
+        return i;
+#endif
+      }
+
+      XYZ_JSON_FORCE_INLINE std::uint64_t prefixXor(std::uint64_t mask) {
+        // Bit i of the result is the parity of bits 0..i of mask.
+        mask ^= mask << 1;
+        mask ^= mask << 2;
+        mask ^= mask << 4;
+        mask ^= mask << 8;
+        mask ^= mask << 16;
+        mask ^= mask << 32;
+        return mask;
+      }
+
+      inline bool isSpecialInString(unsigned char in) {
+        return in == '"' || in == '\\' || in <= 0x1f;
+      }
+
+      inline bool isEscapeSpecial(unsigned char in) {
+        return in == '"' || in == '\\' || in <= 0x1f || in >= 0x7f;
+      }
+
+      // Bit i of each mask is set if byte i of a 64 byte block belongs to the class.
+      struct BlockMasks {
+        std::uint64_t quote;
+        std::uint64_t backslash;
+        std::uint64_t op;          // { } [ ] : ,
+        std::uint64_t whitespace;  // space, tab, line feed, carriage return
+        std::uint64_t slash;
+      };
+
+      struct ScalarClassifier {
+        static XYZ_JSON_FORCE_INLINE void classify(const char *block, BlockMasks &masks) {
+          masks.quote = masks.backslash = masks.op = masks.whitespace = masks.slash = 0;
+
+          for(unsigned i = 0; i < 64; ++i) {
+            std::uint64_t bit = std::uint64_t(1) << i;
+            switch(block[i]) {
+              case '"': masks.quote |= bit; break;
+              case '\\': masks.backslash |= bit; break;
+              case '/': masks.slash |= bit; break;
+              case '{': case '}': case '[': case ']': case ':': case ',': masks.op |= bit; break;
+              case ' ': case '\t': case '\n': case '\r': masks.whitespace |= bit; break;
+              default: break;
+            }
+          }
+        }
+      };
+
+#ifdef XYZ_JSON_SSE2
+      struct SSE2Classifier {
+        static XYZ_JSON_FORCE_INLINE void classify(const char *block, BlockMasks &masks) {
+          const __m128i lower = _mm_set1_epi8(0x20);
+
+          masks.quote = masks.backslash = masks.op = masks.whitespace = masks.slash = 0;
+
+          for(unsigned i = 0; i < 4; ++i) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+            // '[' and ']' differ from '{' and '}' only in bit 0x20.
+            __m128i folded = _mm_or_si128(v, lower);
+
+            __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                                                   _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                                      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                                                   _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+            __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                                   _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                                   _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+
+            unsigned shift = 16 * i;
+            masks.quote |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))))) << shift;
+            masks.backslash |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))))) << shift;
+            masks.slash |= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('/'))))) << shift;
+            masks.op |= std::uint64_t(unsigned(_mm_movemask_epi8(op))) << shift;
+            masks.whitespace |= std::uint64_t(unsigned(_mm_movemask_epi8(ws))) << shift;
+          }
+        }
+      };
+#endif
+
+#ifdef XYZ_JSON_AVX2
+      struct AVX2Classifier {
+        static __attribute__((target("avx2"))) inline void classify(const char *block, BlockMasks &masks) {
+          const __m256i lower = _mm256_set1_epi8(0x20);
+
+          masks.quote = masks.backslash = masks.op = masks.whitespace = masks.slash = 0;
+
+          for(unsigned i = 0; i < 2; ++i) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32 * i));
+            __m256i folded = _mm256_or_si256(v, lower);
+
+            __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                                                         _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+                                         _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')),
+                                                         _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+            __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                         _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                         _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                                         _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+
+            unsigned shift = 32 * i;
+            masks.quote |= std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))))) << shift;
+            masks.backslash |= std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))))) << shift;
+            masks.slash |= std::uint64_t(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))))) << shift;
+            masks.op |= std::uint64_t(unsigned(_mm256_movemask_epi8(op))) << shift;
+            masks.whitespace |= std::uint64_t(unsigned(_mm256_movemask_epi8(ws))) << shift;
+          }
+        }
+      };
+#endif
+
+      template<typename Classifier>
+      XYZ_JSON_FORCE_INLINE long scanBlocks(const char *data, std::size_t size, ScanState &state, std::uint32_t *positions) {
+        std::uint32_t *out = positions;
+
+        for(std::size_t offset = 0; offset < size; offset += 64) {
+          const char *block = data + offset;
+
+          // The last block is padded with whitespace.
+          char padded[64];
+          if(size - offset < 64) {
+            std::memset(padded, ' ', sizeof(padded));
+            std::memcpy(padded, block, size - offset);
+            block = padded;
+          }
+
+          BlockMasks masks;
+          Classifier::classify(block, masks);
+
+          // A backslash escapes the next byte, unless it is itself escaped. Backslashes are rare enough
+          // to handle one at a time.
+          std::uint64_t escaped = state.prevEscaped;
+          std::uint64_t escapes = masks.backslash & ~state.prevEscaped;
+          state.prevEscaped = 0;
+          while(escapes) {
+            unsigned i = lowestBit(escapes);
+            escapes &= escapes - 1;
+            if(i == 63) {
+              state.prevEscaped = 1;
+            }
+            else {
+              std::uint64_t next = std::uint64_t(1) << (i + 1);
+              escaped |= next;
+              escapes &= ~next;
+            }
+          }
+
+          // Set from an opening quote up to, but not including, the closing quote.
+          std::uint64_t quote = masks.quote & ~escaped;
+          std::uint64_t inString = prefixXor(quote) ^ state.prevInString;
+          state.prevInString = (inString >> 63) ? ~std::uint64_t(0) : 0;
+
+          std::uint64_t outside = ~inString;
+          if(masks.slash & outside) {
+            return -1;
+          }
+
+          // Anything else outside a string is part of a number or literal, which is indexed at its first byte.
+          std::uint64_t scalar = ~(masks.op | masks.whitespace | quote) & outside;
+          std::uint64_t scalarStart = scalar & ~((scalar << 1) | state.prevScalar);
+          state.prevScalar = scalar >> 63;
+
+          std::uint64_t structural = (masks.op & outside) | (quote & inString) | scalarStart;
+          while(structural) {
+            *out++ = std::uint32_t(offset + lowestBit(structural));
+            structural &= structural - 1;
+          }
+        }
+
+        return long(out - positions);
+      }
+
+      long scanBlocksScalar(const char *data, std::size_t size, ScanState &state, std::uint32_t *positions) {
+        return scanBlocks<ScalarClassifier>(data, size, state, positions);
+      }
+
+#ifdef XYZ_JSON_SSE2
+      long scanBlocksSSE2(const char *data, std::size_t size, ScanState &state, std::uint32_t *positions) {
+        return scanBlocks<SSE2Classifier>(data, size, state, positions);
+      }
+#endif
+
+#ifdef XYZ_JSON_AVX2
+      __attribute__((target("avx2")))
+      long scanBlocksAVX2(const char *data, std::size_t size, ScanState &state, std::uint32_t *positions) {
+        return scanBlocks<AVX2Classifier>(data, size, state, positions);
+      }
+#endif
+
+      ScanBlocks blockScanner() {
+#ifdef XYZ_JSON_AVX2
+        static const ScanBlocks best = __builtin_cpu_supports("avx2") ? scanBlocksAVX2 : scanBlocksSSE2;
+        return best;
+#elif defined(XYZ_JSON_SSE2)
+        return scanBlocksSSE2;
+#else
+        return scanBlocksScalar;
+#endif
+      }
+
+      const char *findStringSpecial(const char *pos, const char *end) {
+#ifdef XYZ_JSON_SSE2
+        const __m128i ctrlMax = _mm_set1_epi8(0x1f);
+
+        while(end - pos >= 16) {
+          __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+          // Unsigned v <= 0x1f.
+          __m128i ctrl = _mm_cmpeq_epi8(_mm_max_epu8(v, ctrlMax), ctrlMax);
+
+          __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                                      _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                                         ctrl);
+          unsigned mask = unsigned(_mm_movemask_epi8(special));
+          if(mask) {
+            return pos + lowestBit(mask);
+          }
+          pos += 16;
+        }
+#endif
+        while(pos < end && !isSpecialInString(static_cast<unsigned char>(*pos))) {
+          ++pos;
+        }
+        return pos;
+      }
+
+#ifdef XYZ_JSON_AVX2
+      __attribute__((target("avx2")))
+      const char *findEscapeSpecialAVX2(const char *pos, const char *end) {
+        while(end - pos >= 32) {
+          __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos));
+          // Signed v < 0x20 covers both control characters and bytes from 0x80 up.
+          __m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f)),
+                                                            _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v)));
+          unsigned mask = unsigned(_mm256_movemask_epi8(special));
+          if(mask) {
+            return pos + lowestBit(mask);
+          }
+          pos += 32;
+        }
+        return pos;
+      }
+#endif
+
+      const char *findEscapeSpecial(const char *pos, const char *end) {
+#ifdef XYZ_JSON_AVX2
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        if(avx2) {
+          pos = findEscapeSpecialAVX2(pos, end);
+        }
+#endif
+#ifdef XYZ_JSON_SSE2
+        while(end - pos >= 16) {
+          __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+          // Signed v < 0x20 covers both control characters and bytes from 0x80 up.
+          __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                                      _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                                         _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)),
+                                                      _mm_cmplt_epi8(v, _mm_set1_epi8(0x20))));
+          unsigned mask = unsigned(_mm_movemask_epi8(special));
+          if(mask) {
+            return pos + lowestBit(mask);
+          }
+          pos += 16;
+        }
+#endif
+        while(pos < end && !isEscapeSpecial(static_cast<unsigned char>(*pos))) {
+          ++pos;
+        }
+        return pos;
+      }
+
+      const char *skipWhitespaceRun(const char *pos, const char *end) {
+#ifdef XYZ_JSON_SSE2
+        while(end - pos >= 16) {
+          __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+          __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+          unsigned mask = unsigned(_mm_movemask_epi8(ws)) ^ 0xffff;
+          if(mask) {
+            return pos + lowestBit(mask);
+          }
+          pos += 16;
+        }
+#endif
+        while(pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) {
+          ++pos;
+        }
+        return pos;
+      }
+
+      bool indexBytes(const char *data, std::size_t begin, std::size_t size, const ScanState &state,
+                      std::vector<std::uint32_t> &positions) {
+        // One byte at a time, for input with line comments.
+        bool inString = state.prevInString != 0;
+        bool escaped = state.prevEscaped != 0;
+        bool scalar = state.prevScalar != 0;
+
+        for(std::size_t i = begin; i < size; ++i) {
+          char in = data[i];
+          if(inString) {
+            if(escaped) escaped = false;
+            else if(in == '\\') escaped = true;
+            else if(in == '"') inString = false;
+            continue;
+          }
+
+          switch(in) {
+            case '"':
+              positions.push_back(std::uint32_t(i));
+              inString = true;
+              scalar = false;
+              break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+              positions.push_back(std::uint32_t(i));
+              scalar = false;
+              break;
+            case ' ': case '\t': case '\n': case '\r':
+              scalar = false;
+              break;
+            case '/':
+              if(i + 1 < size && data[i + 1] == '/') {
+                while(i + 1 < size && data[i + 1] != '\n' && data[i + 1] != '\r') {
+                  ++i;
+                }
+                scalar = false;
+                break;
+              }
+              // Fall through, the parser reports the stray '/'.
+            default:
+              if(!scalar) {
+                positions.push_back(std::uint32_t(i));
+              }
+              scalar = true;
+              break;
+          }
+        }
+        return !inString;
+      }
+
+      bool indexStructurals(const char *data, std::size_t size, std::vector<std::uint32_t> &positions) {
+        static const std::size_t WINDOW = 64 * 1024;
+
+        ScanBlocks scan = blockScanner();
+        ScanState state;
+        std::vector<std::uint32_t> window(size < WINDOW ? size : WINDOW);
+
+        for(std::size_t offset = 0; offset < size; offset += WINDOW) {
+          std::size_t windowSize = size - offset < WINDOW ? size - offset : WINDOW;
+          ScanState start = state;
+          long found = scan(data + offset, windowSize, state, window.data());
+          if(found < 0) {
+            // A comment, finish from the start of this window.
+            return indexBytes(data, offset, size, start, positions);
+          }
+          for(long i = 0; i < found; ++i) {
+            positions.push_back(std::uint32_t(offset + window[std::size_t(i)]));
+          }
+        }
+        return !state.prevInString;
+      }
+
+      // Bytes indexed per window. Bounds the size of the position buffer.
+      static const std::size_t WINDOW_SIZE = 64 * 1024;
+
+      StructuralIndex::StructuralIndex(const char *data, std::size_t size)
+        :scan(blockScanner())
+      {
+        reset(data, size);
+      }
+
+      void StructuralIndex::reset(const char *data, std::size_t size) {
+        end = data + size;
+        scanned = data;
+        disabled = false;
+        count = 0;
+        current = 0;
+        windowBase = data;
+        state = ScanState();
+
+        std::size_t needed = size < WINDOW_SIZE ? size : WINDOW_SIZE;
+        if(positions.size() < needed) {
+          positions.resize(needed);
+        }
+      }
+
+      const char *StructuralIndex::nextWindow(const char *pos) {
+        while(!disabled) {
+          if(scanned == end) {
+            if(pos < end && !isWhitespace(*pos)) {
+              return pos;
+            }
+            return end;
+          }
+
+          std::size_t remaining = std::size_t(end - scanned);
+          std::size_t windowSize = remaining < WINDOW_SIZE ? remaining : WINDOW_SIZE;
+
+          long found = scan(scanned, windowSize, state, positions.data());
+          if(found < 0) {
+            disabled = true;
+            count = 0;
+            break;
+          }
+
+          windowBase = scanned;
+          scanned += windowSize;
+          count = std::size_t(found);
+          current = 0;
+
+          for(; current < count; ++current) {
+            const char *structural = windowBase + positions[current];
+            if(structural >= pos) {
+              if(structural == pos || isWhitespace(*pos)) {
+                return structural;
+              }
+              return pos;
+            }
+          }
+        }
+
+        return nullptr;
+      }
+
+    }
+  }
+}
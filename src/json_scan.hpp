@@ -0,0 +1,123 @@
+/*
+
+Copyright (c) 2016 xyzdev.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef XYZDEV_JSON_SCAN_HPP
+#define XYZDEV_JSON_SCAN_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Stage-1 scanning for the JSON parser: classifies input 64 bytes at a time (SSE2/AVX2 where available,
+ * with a scalar fallback chosen at runtime) and produces the positions of structural characters,
+ * so the parser can jump from token to token instead of stepping over whitespace byte by byte.
+ */
+
+namespace xyz {
+  namespace json {
+    namespace detail {
+
+      // Classification state carried from one 64 byte block to the next.
+      struct ScanState {
+        ScanState():prevInString(0),prevEscaped(0),prevScalar(0) {}
+
+        std::uint64_t prevInString;  // All ones if the previous block ended inside a string.
+        std::uint64_t prevEscaped;   // 1 if the first byte of the next block is escaped.
+        std::uint64_t prevScalar;    // 1 if the previous block ended inside a number or literal.
+      };
+
+      // Writes the offsets of structural characters in [data, data + size) to positions, which must have
+      // room for size entries, and returns the number written. Returns -1 if a line comment is found.
+      typedef long (*ScanBlocks)(const char *data, std::size_t size, ScanState &state, std::uint32_t *positions);
+
+      // Returns the fastest block scanner supported by the running CPU.
+      ScanBlocks blockScanner();
+
+      // Appends the offsets of all structural characters in [data, data + size) to positions, by the rules of
+      // ScanBlocks. Line comments are skipped instead of stopping the scan, and a '/' which does not begin
+      // one is indexed like the first byte of a number or literal. size must be below 4 GiB.
+      // Returns false if the input ends inside a string.
+      bool indexStructurals(const char *data, std::size_t size, std::vector<std::uint32_t> &positions);
+
+      // Returns the first quote, backslash or control character in [pos, end), or end if there is none.
+      const char *findStringSpecial(const char *pos, const char *end);
+
+      // Returns the first quote, backslash, control character or non-ASCII byte in [pos, end), or end if
+      // there is none. These are the characters which may need escaping on output.
+      const char *findEscapeSpecial(const char *pos, const char *end);
+
+      // Returns the first character in [pos, end) which is not whitespace, or end if there is none.
+      const char *skipWhitespaceRun(const char *pos, const char *end);
+
+      class StructuralIndex {
+      public:
+        StructuralIndex(const char *data, std::size_t size);
+
+        // Start over on new input, keeping the position buffer.
+        void reset(const char *data, std::size_t size);
+
+        // Returns the first structural position at or after pos, or pos itself if it holds a character
+        // that is neither whitespace nor structural (i.e. trailing garbage after a primitive).
+        // Returns end if only whitespace remains.
+        // Returns nullptr if the input from pos onward contains a line comment, which the scanner does
+        // not handle; the caller must then skip whitespace itself for the rest of the input.
+        const char *next(const char *pos) {
+          for(; current < count; ++current) {
+            const char *structural = windowBase + positions[current];
+            if(structural >= pos) {
+              if(structural == pos || isWhitespace(*pos)) {
+                return structural;
+              }
+              return pos;
+            }
+          }
+          return nextWindow(pos);
+        }
+
+      private:
+        static bool isWhitespace(char in) {
+          return in == ' ' || in == '\n' || in == '\r' || in == '\t';
+        }
+
+        const char *nextWindow(const char *pos);
+
+        const char *end;
+        const char *scanned;  // Input before this has been indexed.
+        bool disabled;
+
+        // Structural positions of the most recent window, relative to windowBase.
+        std::vector<std::uint32_t> positions;
+        std::size_t count;
+        std::size_t current;
+        const char *windowBase;
+
+        ScanState state;
+        ScanBlocks scan;
+      };
+
+    }
+  }
+}
+
+#endif
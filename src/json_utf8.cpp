@@ -0,0 +1,215 @@
+/*
+
+Copyright (c) 2016 xyzdev.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "json_utf8.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XYZ_JSON_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace xyz {
+  namespace json {
+    namespace detail {
+
+      const char *validateUtf8Scalar(const char *pos, const char *end) {
+        while(pos < end) {
+          // Skip ASCII a word at a time.
+          while(end - pos >= 8) {
+            std::uint64_t word;
+            std::memcpy(&word, pos, sizeof(word));
+            if(word & 0x8080808080808080ULL) {
+              break;
+            }
+            pos += 8;
+          }
+          if(pos == end) {
+            break;
+          }
+
+          if(static_cast<unsigned char>(*pos) < 0x80) {
+            ++pos;
+            continue;
+          }
+
+          std::uint32_t code;
+          std::size_t length = decodeUtf8(pos, end, code);
+          if(!length) {
+            return pos;
+          }
+          pos += length;
+        }
+        return end;
+      }
+
+#ifdef XYZ_JSON_AVX2
+      // Validation by table lookups on the high and low nibbles of each byte and the one before it,
+      // as described in John Keiser, Daniel Lemire, "Validating UTF-8 In Less Than One Instruction
+      // Per Byte" (2021). Each table entry has one bit per kind of error; a bit set in all three
+      // lookups is an error. Sequences of three and four bytes are checked in addition by comparing
+      // against the bytes two and three positions back.
+
+      static const unsigned char TOO_SHORT = 1 << 0;       // Lead byte or ASCII followed by a lead byte or ASCII.
+      static const unsigned char TOO_LONG = 1 << 1;        // ASCII followed by a continuation byte.
+      static const unsigned char OVERLONG_3 = 1 << 2;      // 11100000 100_____
+      static const unsigned char TOO_LARGE = 1 << 3;       // 11110100 1001____ and above.
+      static const unsigned char SURROGATE = 1 << 4;       // 11101101 101_____
+      static const unsigned char OVERLONG_2 = 1 << 5;      // 1100000_ 10______
+      static const unsigned char TOO_LARGE_1000 = 1 << 6;  // 11110101 1000____ and above.
+      static const unsigned char OVERLONG_4 = 1 << 6;      // 11110000 1000____
+      static const unsigned char TWO_CONTS = 1 << 7;       // Continuation byte following a continuation byte.
+      static const unsigned char CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+      __attribute__((target("avx2"))) inline __m256i lookup(const unsigned char *table, __m256i index) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(table));
+        return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(half), index);
+      }
+
+      __attribute__((target("avx2"))) inline __m256i highNibbles(__m256i v) {
+        return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+      }
+
+      template<int N>
+      __attribute__((target("avx2"))) inline __m256i previous(__m256i input, __m256i prevInput) {
+        // The bytes N positions before those of input, continuing from the end of prevInput.
+        return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prevInput, input, 0x21), 16 - N);
+      }
+
+      __attribute__((target("avx2"))) inline __m256i checkBlock(__m256i input, __m256i prevInput) {
+        static const unsigned char BYTE_1_HIGH[16] = {
+          // ASCII
+          TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+          // Continuation
+          TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+          // 1100____, 1101____
+          TOO_SHORT | OVERLONG_2,
+          TOO_SHORT,
+          // 1110____
+          TOO_SHORT | OVERLONG_3 | SURROGATE,
+          // 1111____
+          TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+        };
+        static const unsigned char BYTE_1_LOW[16] = {
+          CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+          CARRY | OVERLONG_2,
+          CARRY,
+          CARRY,
+          CARRY | TOO_LARGE,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+          CARRY | TOO_LARGE | TOO_LARGE_1000,
+          CARRY | TOO_LARGE | TOO_LARGE_1000
+        };
+        static const unsigned char BYTE_2_HIGH[16] = {
+          // ASCII
+          TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+          // 1000____, 1001____, 101_____
+          TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+          TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+          TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+          TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+          // Lead bytes
+          TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+        };
+
+        __m256i prev1 = previous<1>(input, prevInput);
+        __m256i special = _mm256_and_si256(
+          _mm256_and_si256(lookup(BYTE_1_HIGH, highNibbles(prev1)),
+                           lookup(BYTE_1_LOW, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0f)))),
+          lookup(BYTE_2_HIGH, highNibbles(input)));
+
+        // The third and fourth byte of a sequence must be continuation bytes, which the lookup flags as TWO_CONTS.
+        __m256i third = _mm256_subs_epu8(previous<2>(input, prevInput), _mm256_set1_epi8(char(0xe0 - 0x80)));
+        __m256i fourth = _mm256_subs_epu8(previous<3>(input, prevInput), _mm256_set1_epi8(char(0xf0 - 0x80)));
+        __m256i expected = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(char(0x80)));
+        return _mm256_xor_si256(expected, special);
+      }
+
+      __attribute__((target("avx2"))) inline __m256i incompleteAtEnd(__m256i input) {
+        // Nonzero if the block ends within a sequence of two, three or four bytes.
+        const __m256i maximum = _mm256_setr_epi8(
+          char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff),
+          char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff),
+          char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xff),
+          char(0xff), char(0xff), char(0xff), char(0xff), char(0xff), char(0xf0 - 1), char(0xe0 - 1), char(0xc0 - 1));
+        return _mm256_subs_epu8(input, maximum);
+      }
+
+      __attribute__((target("avx2")))
+      bool isValidUtf8AVX2(const char *pos, const char *end) {
+        __m256i prevInput = _mm256_setzero_si256();
+        __m256i prevIncomplete = _mm256_setzero_si256();
+        __m256i error = _mm256_setzero_si256();
+
+        while(end - pos >= 32) {
+          __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos));
+          if(!_mm256_movemask_epi8(input)) {
+            // All ASCII, only a sequence left open by the previous block can be wrong.
+            error = _mm256_or_si256(error, prevIncomplete);
+          }
+          else {
+            error = _mm256_or_si256(error, checkBlock(input, prevInput));
+            prevIncomplete = incompleteAtEnd(input);
+          }
+          prevInput = input;
+          pos += 32;
+        }
+
+        // The rest is padded with ASCII zeros, which also catches a sequence left open at the end.
+        char tail[32] = {0};
+        std::memcpy(tail, pos, std::size_t(end - pos));
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tail));
+        error = _mm256_or_si256(error, checkBlock(input, prevInput));
+
+        return _mm256_testz_si256(error, error) != 0;
+      }
+#endif
+
+      const char *validateUtf8(const char *pos, const char *end) {
+#ifdef XYZ_JSON_AVX2
+        // Short runs are not worth setting up the vector registers for.
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        if(avx2 && end - pos >= 32) {
+          if(isValidUtf8AVX2(pos, end)) {
+            return end;
+          }
+          // Find the exact position for the error message.
+        }
+#endif
+        return validateUtf8Scalar(pos, end);
+      }
+
+    }
+  }
+}
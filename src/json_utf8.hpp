@@ -0,0 +1,111 @@
+/*
+
+Copyright (c) 2016 xyzdev.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef XYZDEV_JSON_UTF8_HPP
+#define XYZDEV_JSON_UTF8_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace xyz {
+  namespace json {
+    namespace detail {
+
+      // Decodes the UTF-8 sequence at pos into code and returns its length. Returns 0 if it is not valid
+      // UTF-8, which includes truncated sequences, overlong forms, surrogates and values above U+10FFFF.
+      inline std::size_t decodeUtf8(const char *pos, const char *end, std::uint32_t &code) {
+        const unsigned char *in = reinterpret_cast<const unsigned char *>(pos);
+        unsigned char lead = in[0];
+
+        std::size_t length;
+        std::uint32_t minimum;
+        if(lead < 0x80) {
+          code = lead;
+          return 1;
+        }
+        else if((lead & 0xe0) == 0xc0) {
+          length = 2;
+          code = lead & 0x1f;
+          minimum = 0x80;
+        }
+        else if((lead & 0xf0) == 0xe0) {
+          length = 3;
+          code = lead & 0x0f;
+          minimum = 0x800;
+        }
+        else if((lead & 0xf8) == 0xf0) {
+          length = 4;
+          code = lead & 0x07;
+          minimum = 0x10000;
+        }
+        else {
+          return 0;
+        }
+
+        if(std::size_t(end - pos) < length) {
+          return 0;
+        }
+
+        for(std::size_t i = 1; i < length; ++i) {
+          if((in[i] & 0xc0) != 0x80) {
+            return 0;
+          }
+          code = (code << 6) | (in[i] & 0x3f);
+        }
+
+        if(code < minimum || code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff)) {
+          return 0;
+        }
+        return length;
+      }
+
+      // Returns the first byte in [pos, end) which is not part of valid UTF-8, or end if there is none.
+      // Checks 32 bytes at a time with AVX2 where available.
+      const char *validateUtf8(const char *pos, const char *end);
+
+      // Appends code to str as UTF-8. Code must be at most U+10FFFF.
+      inline void encodeUtf8(std::uint32_t code, std::string &str) {
+        if(code < 0x80) {
+          str += char(code);
+        }
+        else if(code < 0x800) {
+          char bytes[2] = {char(0xc0 | (code >> 6)), char(0x80 | (code & 0x3f))};
+          str.append(bytes, 2);
+        }
+        else if(code < 0x10000) {
+          char bytes[3] = {char(0xe0 | (code >> 12)), char(0x80 | ((code >> 6) & 0x3f)), char(0x80 | (code & 0x3f))};
+          str.append(bytes, 3);
+        }
+        else {
+          char bytes[4] = {char(0xf0 | (code >> 18)), char(0x80 | ((code >> 12) & 0x3f)),
+                           char(0x80 | ((code >> 6) & 0x3f)), char(0x80 | (code & 0x3f))};
+          str.append(bytes, 4);
+        }
+      }
+
+    }
+  }
+}
+
+#endif
@@ -28,6 +28,11 @@ SOFTWARE.
 #include <sstream>
 #include <map>
 #include <type_traits>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
 
 /**
  * Reflector: Reads or writes a member to/from json::Element.
@@ -86,6 +91,19 @@ namespace xyz {
     public:
       virtual json::Element read() = 0;
       virtual void write(const json::Element &data) = 0;
+
+      // Like read, but with containers and strings allocated by allocator, e.g. in a json::Document.
+      // Reflectors which do not override this allocate on the heap.
+      virtual json::Element readWith(const json::Allocator<char> &allocator) {
+        return read();
+      }
+
+      // Like write, but reading straight from a lazily parsed document, so no element tree is built.
+      // Reflectors which do not override this decode the value into an element first.
+      virtual void writeLazy(const json::LazyDocument::Value &data) {
+        write(data.toElement());
+      }
+
       virtual bool isMethod() { return false; }
 
       virtual json::Element call(const json::Array &data) {
@@ -105,6 +123,10 @@ namespace xyz {
         return json::Element(detail::toString(field));
       }
 
+      json::Element readWith(const json::Allocator<char> &allocator) {
+        return json::Element(detail::toString(field), allocator);
+      }
+
       void write(const json::Element &data) {
         if(data.getType() != json::Element::NULL_VALUE) {
           field = detail::fromString<Field>(data.str());
@@ -113,6 +135,14 @@ namespace xyz {
         }
       }
 
+      void writeLazy(const json::LazyDocument::Value &data) {
+        if(!data.isNull()) {
+          field = detail::fromString<Field>(data.str());
+        } else {
+          field = Field();
+        }
+      }
+
     protected:
       Field &field;
     };
@@ -143,6 +173,10 @@ namespace xyz {
         return json::Element(field);
       }
 
+      json::Element readWith(const json::Allocator<char> &allocator) {
+        return json::Element(json::String(field), allocator);
+      }
+
       void write(const json::Element &data) {
         if(data.getType() != json::Element::NULL_VALUE) {
           field = data.str();
@@ -151,21 +185,48 @@ namespace xyz {
         }
       }
 
+      void writeLazy(const json::LazyDocument::Value &data) {
+        if(!data.isNull()) {
+          json::StringView view = data.view();
+          field.assign(view.data(), view.size());
+        } else {
+          field = field_type();
+        }
+      }
+
     protected:
         field_type &field;
     };
 
     template<typename Field>
     class Reflector<Field, typename std::enable_if<std::is_integral<Field>::value>::type>: public AbstractReflector {
+      // Integers are passed through json::Integer or json::UnsignedInteger, so 64 bit values are kept exactly.
     public:
       Reflector(Field &field):field(field) {}
 
       json::Element read() {
-        return json::Element(json::Number(field));
+        if(std::is_signed<Field>::value) {
+          return json::Element(json::Integer(field));
+        }
+        return json::Element(json::UnsignedInteger(field));
       }
 
       void write(const json::Element &data) {
-        field = Field(data.number());
+        if(std::is_signed<Field>::value) {
+          field = Field(data.integer());
+        }
+        else {
+          field = Field(data.unsignedInteger());
+        }
+      }
+
+      void writeLazy(const json::LazyDocument::Value &data) {
+        if(std::is_signed<Field>::value) {
+          field = Field(data.integer());
+        }
+        else {
+          field = Field(data.unsignedInteger());
+        }
       }
 
     protected:
@@ -185,6 +246,10 @@ namespace xyz {
         field = Field(data.number());
       }
 
+      void writeLazy(const json::LazyDocument::Value &data) {
+        field = Field(data.number());
+      }
+
     protected:
       Field &field;
     };
@@ -197,14 +262,26 @@ namespace xyz {
       field = (data.getType() != json::Element::NULL_VALUE) ? bool(data.boolean()) : bool();
     }
 
+    template<> inline void Reflector<bool>::writeLazy(const json::LazyDocument::Value &data) {
+      field = !data.isNull() ? bool(data.boolean()) : bool();
+    }
+
     template<> inline json::Element Reflector<json::Element>::read() {
       return field;
     }
 
+    template<> inline json::Element Reflector<json::Element>::readWith(const json::Allocator<char> &allocator) {
+      return field;
+    }
+
     template<> inline void Reflector<json::Element>::write(const json::Element &data) {
       field = data;
     }
 
+    template<> inline void Reflector<json::Element>::writeLazy(const json::LazyDocument::Value &data) {
+      field = data.toElement();
+    }
+
     // TODO: This breaks non-collection templated fields.
     template<template<typename ...> class Container, typename ... Args>
     class Reflector< Container<Args...> >: public AbstractReflector {
@@ -216,13 +293,17 @@ namespace xyz {
         :field(field) {}
 
       json::Element read() {
-        json::Array array;
+        return readWith(json::Allocator<char>());
+      }
+
+      json::Element readWith(const json::Allocator<char> &allocator) {
+        json::Element array(json::Element::ARRAY, allocator);
         for(typename field_type::iterator i = field.begin(); i != field.end(); ++i) {
           Reflector<element_type> refl(*i);
-          array.push_back(refl.read());
+          array.append(refl.readWith(allocator));
         }
-        return json::Element(array);
-      };
+        return array;
+      }
 
       void write(const json::Element &data) {
         std::vector<element_type> v;
@@ -231,10 +312,24 @@ namespace xyz {
             element_type elem;
             Reflector<element_type> refl(elem);
             refl.write(*i);
-            v.push_back(elem);
+            v.push_back(std::move(elem));
           }
         }
-        field = field_type(v.begin(), v.end());
+        field = field_type(std::make_move_iterator(v.begin()), std::make_move_iterator(v.end()));
+      }
+
+      void writeLazy(const json::LazyDocument::Value &data) {
+        std::vector<element_type> v;
+        if(!data.isNull()) {
+          json::LazyDocument::Array array = data.array();
+          for(json::LazyDocument::Array::const_iterator i = array.begin(); i != array.end(); ++i) {
+            element_type elem;
+            Reflector<element_type> refl(elem);
+            refl.writeLazy(*i);
+            v.push_back(std::move(elem));
+          }
+        }
+        field = field_type(std::make_move_iterator(v.begin()), std::make_move_iterator(v.end()));
       }
 
     protected:
@@ -250,12 +345,16 @@ namespace xyz {
         :field(field) {}
 
       json::Element read() {
-        json::Object obj;
+        return readWith(json::Allocator<char>());
+      }
+
+      json::Element readWith(const json::Allocator<char> &allocator) {
+        json::Element obj(json::Element::OBJECT, allocator);
         for(typename field_type::iterator i = field.begin(); i != field.end(); ++i) {
           Reflector<Value> refl(i->second);
-          obj[detail::toString(i->first)] = refl.read();
+          obj.set(json::Key(detail::toString(i->first)), refl.readWith(allocator));
         }
-        return json::Element(obj);
+        return obj;
       }
 
       void write(const json::Element &data) {
@@ -265,7 +364,20 @@ namespace xyz {
             Value elem;
             Reflector<Value> refl(elem);
             refl.write(i->second);
-            field[detail::fromString<Key>(i->first)] = elem;
+            field[detail::fromString<Key>(i->first)] = std::move(elem);
+          }
+        }
+      }
+
+      void writeLazy(const json::LazyDocument::Value &data) {
+        field.clear();
+        if(!data.isNull()) {
+          json::LazyDocument::Object object = data.object();
+          for(json::LazyDocument::Object::const_iterator i = object.begin(); i != object.end(); ++i) {
+            Value elem;
+            Reflector<Value> refl(elem);
+            refl.writeLazy(i->second);
+            field[detail::fromString<Key>(i->first.str())] = std::move(elem);
           }
         }
       }
@@ -289,6 +401,12 @@ namespace xyz {
         return refl.read();
       }
 
+      json::Element readWith(const json::Allocator<char> &allocator) {
+        Property val((instance.*getter)());
+        Reflector<Property> refl(val);
+        return refl.readWith(allocator);
+      }
+
       void write(const json::Element &data) {
         Property val((instance.*getter)());
         Reflector<Property> refl(val);
@@ -296,6 +414,13 @@ namespace xyz {
         (instance.*setter)(val);
       }
 
+      void writeLazy(const json::LazyDocument::Value &data) {
+        Property val((instance.*getter)());
+        Reflector<Property> refl(val);
+        refl.writeLazy(data);
+        (instance.*setter)(val);
+      }
+
     protected:
       Class &instance;
       Property (Class::*getter)();
@@ -311,33 +436,40 @@ namespace xyz {
     public:
       ReflectionSink():methods(false),sink(json::Element::OBJECT) {}
 
+      // Build the element with storage from allocator, e.g. json::Document::allocator().
+      explicit ReflectionSink(const json::Allocator<char> &allocator)
+        :methods(false),sink(json::Element::OBJECT, allocator),allocator(allocator) {}
+
       virtual void visit(AbstractReflector &reflector, const char *name) {
         if(reflector.isMethod() != methods) return;
 
-        json::Element data = reflector.read();
         if(name) {
-          sink.object()[name] = data;
+          sink.set(json::Key::intern(name), reflector.readWith(allocator));
         }
         else {
-          sink = data;
+          sink = reflector.readWith(allocator);
         }
       }
 
       bool methods;
       json::Element sink;
+      json::Allocator<char> allocator;
     };
 
     class ReflectionSource: public Reflection {
     public:
       ReflectionSource():source(json::Element::OBJECT) {}
       ReflectionSource(const json::Element &source):source(source) {}
+      ReflectionSource(json::Element &&source):source(std::move(source)) {}
 
       virtual void visit(AbstractReflector &reflector, const char *name) {
         if(reflector.isMethod()) return;
 
         if(name) {
-          json::Object::iterator it = source.object().find(name);
-          if (it != source.object().end()) {
+          // Looked up through a const reference, so a source shared with the caller's element is not copied.
+          const json::Object &object = static_cast<const json::Element&>(source).object();
+          json::Object::const_iterator it = object.find(name);
+          if (it != object.end()) {
             reflector.write(it->second);
           }
         }
@@ -349,11 +481,101 @@ namespace xyz {
       json::Element source;
     };
 
+    class LazyReflectionSource: public Reflection {
+      // Source reading fields straight from a value in a json::LazyDocument, so no element tree is built
+      // and primitives are decoded directly into their members. The entries of the object are listed once,
+      // and since fields tend to be reflected in the order their keys appear, each lookup starts after the
+      // previous match.
+    public:
+      LazyReflectionSource(const json::LazyDocument::Value &source):source(source),listed(false),hint(0) {}
+
+      virtual void visit(AbstractReflector &reflector, const char *name) {
+        if(reflector.isMethod()) return;
+
+        if(name) {
+          const json::LazyDocument::Value *value = find(json::StringView(name, std::strlen(name)));
+          if(value) {
+            reflector.writeLazy(*value);
+          }
+        }
+        else {
+          reflector.writeLazy(source);
+        }
+      }
+
+      json::LazyDocument::Value source;
+
+    private:
+      const json::LazyDocument::Value *find(const json::StringView &key) {
+        if(!listed) {
+          list();
+        }
+
+        for(std::size_t n = 0; n < entries.size(); ++n) {
+          std::size_t i = (hint + n) % entries.size();
+          if(entries[i].first == key) {
+            hint = i + 1;
+            return &entries[i].second;
+          }
+        }
+        return nullptr;
+      }
+
+      struct ViewHash {
+        std::size_t operator ()(const json::StringView &view) const {
+          // FNV-1a.
+          std::size_t hash = 2166136261u;
+          for(std::size_t i = 0; i < view.size(); ++i) {
+            hash = (hash ^ static_cast<unsigned char>(view.data()[i])) * 16777619u;
+          }
+          return hash;
+        }
+      };
+
+      void list() {
+        // As in an element, the last of several entries with the same key wins. It takes the place of the
+        // first, so entries stay in the order their keys first appear. Large objects find earlier keys
+        // through a hash table rather than a linear search.
+        static const std::size_t LINEAR_LIMIT = 16;
+        std::unordered_map<json::StringView, std::size_t, ViewHash> positions;
+
+        json::LazyDocument::Object object = source.object();
+        entries.reserve(8);
+        for(json::LazyDocument::Object::const_iterator i = object.begin(); i != object.end(); ++i) {
+          json::StringView key = i->first.view();
+          std::size_t position = entries.size();
+          if(entries.size() < LINEAR_LIMIT) {
+            for(position = 0; position < entries.size() && entries[position].first != key; ++position) {}
+          }
+          else {
+            if(positions.empty()) {
+              for(std::size_t n = 0; n < entries.size(); ++n) {
+                positions.insert(std::make_pair(entries[n].first, n));
+              }
+            }
+            position = positions.insert(std::make_pair(key, entries.size())).first->second;
+          }
+
+          if(position < entries.size()) {
+            entries[position].second = i->second;
+          }
+          else {
+            entries.push_back(std::make_pair(key, i->second));
+          }
+        }
+        listed = true;
+      }
+
+      std::vector<std::pair<json::StringView, json::LazyDocument::Value>> entries;
+      bool listed;
+      std::size_t hint;
+    };
+
     class ReflectionCaller: public Reflection {
     public:
       ReflectionCaller(json::String name, json::Array args)
-        :name(name),
-         args(args),
+        :name(std::move(name)),
+         args(std::move(args)),
          found(false) {}
 
       virtual void visit(xyz::core::AbstractReflector &reflector, const char *name) {
@@ -393,7 +615,13 @@ namespace xyz {
       json::Element read() {
         ReflectionSink sink;
         field.reflect(sink);
-        return sink.sink;
+        return std::move(sink.sink);
+      }
+
+      json::Element readWith(const json::Allocator<char> &allocator) {
+        ReflectionSink sink(allocator);
+        field.reflect(sink);
+        return std::move(sink.sink);
       }
 
       void write(const json::Element &data) {
@@ -405,6 +633,15 @@ namespace xyz {
         }
       }
 
+      void writeLazy(const json::LazyDocument::Value &data) {
+        if(!data.isNull()) {
+          LazyReflectionSource source(data);
+          field.reflect(source);
+        } else {
+          field = Field();
+        }
+      }
+
     protected:
       Field &field;
     };
@@ -505,7 +742,7 @@ namespace xyz {
             sig.push_back(types[i]);
           }
         }
-        return sig;
+        return json::Element(std::move(sig));
       }
 
       virtual void write(const json::Element &data) {
@@ -569,6 +806,31 @@ namespace xyz {
       reflection.visit(reflector, name);
     }
 
+    // Deserialize data straight into field through a LazyReflectionSource, without building an element tree.
+    // The input is validated as a whole first, so it is accepted or rejected exactly as by json::deserialize,
+    // even in parts which no field reads.
+    template<typename Field>
+    void deserialize(const char *data, std::size_t size, Field &field) {
+      json::validate(data, size);
+      json::LazyDocument document;
+      json::deserialize(data, size, document);
+      Reflector<Field> reflector(field);
+      reflector.writeLazy(document.root());
+    }
+
+    template<typename Field>
+    void deserialize(const json::String &str, Field &field) {
+      deserialize(str.data(), str.size(), field);
+    }
+
+    // Like deserialize, reading from a memory mapped file.
+    template<typename Field>
+    void load(const char *path, Field &field) {
+      json::detail::MappedFile file;
+      file.open(path);
+      deserialize(file.data, file.size, field);
+    }
+
   }
 }
 
@@ -0,0 +1,123 @@
+#include "../catch.hpp"
+#include "json.hpp"
+#include <sstream>
+#include <stdexcept>
+
+using namespace xyz::json;
+
+TEST_CASE("ArrayReader buffer", "[core] [json]") {
+  String input = "{\"version\": 2, \"skipped\": [[1], {\"entities\": [0]}, \"]\"],\n"
+                 " \"entities\": [{\"id\": 1}, [true, null], \"text\" // comment\n, 42,], \"after\": 1}";
+
+  ArrayReader reader(input.data(), input.size(), "/entities");
+  Element el;
+
+  REQUIRE(reader.next(el));
+  REQUIRE(el == deserialize("{\"id\": 1}"));
+  REQUIRE(reader.next(el));
+  REQUIRE(el == deserialize("[true, null]"));
+  REQUIRE(reader.next(el));
+  REQUIRE(el == Element("text"));
+  REQUIRE(reader.next(el));
+  REQUIRE(el.integer() == 42);
+  REQUIRE(!reader.next(el));
+  REQUIRE(!reader.next(el));
+
+  String root = "[]";
+  ArrayReader empty(root.data(), root.size());
+  REQUIRE(!empty.next(el));
+
+  ArrayReader nested(input.data(), input.size(), "/skipped/1/entities");
+  REQUIRE(nested.next(el));
+  REQUIRE(el.integer() == 0);
+  REQUIRE(!nested.next(el));
+}
+
+TEST_CASE("ArrayReader stream", "[core] [json]") {
+  std::ostringstream os;
+  os << "{\"header\": {\"tags\": [\"a\", \"b\"]}, \"entities\": [\n";
+  for(int i = 0; i < 10000; ++i) {
+    os << (i ? ",\n" : "") << "{\"id\": " << i << ", \"name\": \"entity \\u0041\", \"tags\": [\"a\", \"b\"]}";
+  }
+  os << "]}";
+
+  std::istringstream stream(os.str());
+  ArrayReader reader(stream, "/entities");
+  Element el;
+  int count = 0;
+  while(reader.next(el)) {
+    REQUIRE(el.object()["id"].integer() == count);
+    REQUIRE(el.object()["name"].str() == "entity A");
+    ++count;
+  }
+  REQUIRE(count == 10000);
+}
+
+TEST_CASE("ArrayReader stream block boundary", "[core] [json]") {
+  // A scalar cut off by the end of a stream block is read again, which must not move the index on twice.
+  const char *scalars[] = { "123456789", "\"straddling\"", "false" };
+  for(int kind = 0; kind < 3; ++kind) {
+    for(int shift = 1; shift < 8; ++shift) {
+      String input = "{\"a\": [";
+      int count = 0;
+      while(input.size() + shift + 2 < 65536) {
+        input += "1,";
+        ++count;
+      }
+      input.append(65536 - std::size_t(shift) - input.size(), ' ');
+      input += scalars[kind];
+      input += ", [10, 20]]}";
+
+      String path = "/a/" + std::to_string(count + 1);
+      std::istringstream stream(input);
+      ArrayReader streamed(stream, path);
+      ArrayReader buffered(input.data(), input.size(), path);
+      Element el;
+      REQUIRE(streamed.next(el));
+      REQUIRE(el.integer() == 10);
+      REQUIRE(buffered.next(el));
+      REQUIRE(el.integer() == 10);
+    }
+  }
+}
+
+TEST_CASE("ArrayReader errors", "[core] [json]") {
+  String input = "{\"object\": {}, \"deep\": {\"a\": [1]}, \"list\": [1, 2 3]}";
+  Element el;
+
+  ArrayReader missing(input.data(), input.size(), "/deep/b");
+  try {
+    missing.next(el);
+    FAIL("Expected missing path to throw.");
+  }
+  catch (std::out_of_range &e) {
+  }
+
+  ArrayReader object(input.data(), input.size(), "/object");
+  try {
+    object.next(el);
+    FAIL("Expected object to throw.");
+  }
+  catch (TypeError &e) {
+  }
+
+  ArrayReader list(input.data(), input.size(), "/list");
+  REQUIRE(list.next(el));
+  REQUIRE(list.next(el));
+  try {
+    list.next(el);
+    FAIL("Expected missing comma to throw.");
+  }
+  catch (SyntaxError &e) {
+  }
+
+  String truncated = "{\"list\": [1, {\"a\":";
+  ArrayReader cut(truncated.data(), truncated.size(), "/list");
+  REQUIRE(cut.next(el));
+  try {
+    cut.next(el);
+    FAIL("Expected truncated element to throw.");
+  }
+  catch (SyntaxError &e) {
+  }
+}
@@ -0,0 +1,80 @@
+#include "../catch.hpp"
+#include "json.hpp"
+#include "reflection.hpp"
+
+using namespace xyz::json;
+
+namespace {
+  class Component {
+  public:
+    void reflect(xyz::core::Reflection &refl) {
+      XYZ_REFLECT(refl, name);
+      XYZ_REFLECT(refl, values);
+    }
+
+    String name;
+    std::vector<int> values;
+  };
+}
+
+TEST_CASE("Document deserialize", "[core] [json]") {
+  Document doc(256);
+  String text = "{\"a\": [1, \"x\", {\"b\": null}], \"long\": \"a string longer than the inline buffer\"}";
+  deserialize(text.data(), text.size(), doc);
+
+  REQUIRE(doc.root() == deserialize(text));
+  REQUIRE(doc.root().object()["a"].array()[2].object().count("b") == 1);
+
+  // Copies are independent of the document.
+  Element copy = doc.root();
+  doc.clear();
+  REQUIRE(doc.root().isNull());
+  REQUIRE(copy == deserialize(text));
+
+  // The arena is reused after clear.
+  text = "[true, {\"c\": \"d\"}]";
+  deserialize(text.data(), text.size(), doc);
+  REQUIRE(serialize(doc.root()) == "[ true, { \"c\": \"d\" } ]");
+}
+
+TEST_CASE("Document elements", "[core] [json]") {
+  Document doc;
+  doc.root() = Element(Element::OBJECT, doc.allocator());
+  Object &root = doc.root().object();
+  root["list"] = Element(Element::ARRAY, doc.allocator());
+  for(int i = 0; i < 100; ++i) {
+    root["list"].array().push_back(Element(Integer(i)));
+    root["key" + std::to_string(i)] = Element(String("value"), doc.allocator());
+  }
+
+  // Heap elements may be added to a document.
+  root["heap"] = Element("heap");
+
+  REQUIRE(root.size() == 102);
+  REQUIRE(root["list"].array()[99].integer() == 99);
+  REQUIRE(root["key50"].str() == "value");
+  REQUIRE(deserialize(serialize(doc.root())) == doc.root());
+}
+
+TEST_CASE("Document reflection sink", "[core] [json]") {
+  Component component;
+  component.name = "player";
+  component.values.push_back(1);
+  component.values.push_back(2);
+
+  Document doc;
+  for(int frame = 0; frame < 3; ++frame) {
+    doc.clear();
+    xyz::core::ReflectionSink sink(doc.allocator());
+    component.reflect(sink);
+    doc.root() = std::move(sink.sink);
+
+    REQUIRE(serialize(doc.root()) == "{ \"name\": \"player\", \"values\": [ 1, 2 ] }");
+  }
+
+  Component actual;
+  xyz::core::ReflectionSource source(doc.root());
+  actual.reflect(source);
+  REQUIRE(actual.name == component.name);
+  REQUIRE(actual.values == component.values);
+}
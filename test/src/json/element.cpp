@@ -0,0 +1,227 @@
+#include "../catch.hpp"
+#include "json.hpp"
+#include <limits>
+#include <stdexcept>
+
+using namespace xyz::json;
+
+TEST_CASE("Element size", "[core] [json]") {
+  // Only the active payload is stored.
+  REQUIRE(sizeof(Element) <= 2 * sizeof(Number));
+}
+
+TEST_CASE("Element assign child", "[core] [json]") {
+  Array ar;
+  ar.push_back(Element("child"));
+  Element el(ar);
+
+  el = el.array()[0];
+  REQUIRE(el == Element("child"));
+
+  Object obj;
+  obj["a"] = Array();
+  obj["a"].array().push_back(Element(Number(1)));
+  el = Element(obj);
+
+  el = el.object()["a"];
+  REQUIRE(el.isArray());
+  REQUIRE(el.array().size() == 1);
+  REQUIRE(el.array()[0] == Element(Number(1)));
+}
+
+TEST_CASE("Element change type", "[core] [json]") {
+  Element el(Element::OBJECT);
+  REQUIRE(el.empty());
+
+  el = Element("str");
+  REQUIRE(el.isString());
+  REQUIRE(!el.empty());
+
+  el = Element(Number(2));
+  REQUIRE(el.number() == 2);
+
+  el = Element(Element::ARRAY);
+  REQUIRE(el.array().empty());
+
+  el = Element(true);
+  REQUIRE(el.boolean());
+
+  el = Element();
+  REQUIRE(el.isNull());
+
+  try {
+    el.str();
+    FAIL("Expected exception on wrong type");
+  }
+  catch (TypeError &e) {
+    REQUIRE(e.expected == Element::STRING);
+  }
+}
+
+TEST_CASE("Element swap", "[core] [json]") {
+  Element a("text");
+  Element b(Number(3));
+
+  a.swap(b);
+
+  REQUIRE(a == Element(Number(3)));
+  REQUIRE(b == Element("text"));
+}
+
+TEST_CASE("Element move", "[core] [json]") {
+  Array ar;
+  ar.push_back(Element("item"));
+  const Element *item = &ar[0];
+
+  Element a(std::move(ar));
+  REQUIRE(a.array().size() == 1);
+  REQUIRE(&a.array()[0] == item);
+
+  Element b(std::move(a));
+  REQUIRE(a.isNull());
+  REQUIRE(&b.array()[0] == item);
+
+  Element c;
+  c = std::move(b);
+  REQUIRE(b.isNull());
+  REQUIRE(&c.array()[0] == item);
+
+  c = std::move(c.array()[0]);
+  REQUIRE(c == Element("item"));
+}
+
+TEST_CASE("Element integer", "[core] [json]") {
+  Element big(Integer(9007199254740993));
+  REQUIRE(big.isInteger());
+  REQUIRE(big.integer() == 9007199254740993);
+  REQUIRE(big.unsignedInteger() == 9007199254740993u);
+  REQUIRE(big.toString() == "9007199254740993");
+
+  // Integers compare exactly with each other and with doubles.
+  REQUIRE(big == Element(UnsignedInteger(9007199254740993u)));
+  REQUIRE(!(big == Element(Number(9007199254740992.0))));
+  REQUIRE(Element(Integer(-3)) == Element(Number(-3)));
+  REQUIRE(!(Element(Integer(-1)) == Element(std::numeric_limits<UnsignedInteger>::max())));
+  REQUIRE(Element(Integer(0)).empty());
+
+  // Doubles are truncated, values out of range throw.
+  REQUIRE(Element(Number(-2.7)).integer() == -2);
+  REQUIRE(Element(Number(2.7)).unsignedInteger() == 2);
+  try {
+    Element(Integer(-1)).unsignedInteger();
+    FAIL("Expected negative value to throw.");
+  }
+  catch (TypeError &e) {
+  }
+  try {
+    Element(std::numeric_limits<UnsignedInteger>::max()).integer();
+    FAIL("Expected large value to throw.");
+  }
+  catch (TypeError &e) {
+  }
+
+  // A mutable reference converts the element to floating point.
+  Element el(Integer(7));
+  el.number() += 0.5;
+  REQUIRE(el.getNumberType() == Element::FLOATING_POINT);
+  REQUIRE(el.number() == 7.5);
+}
+
+TEST_CASE("Object", "[core] [json]") {
+  Object obj;
+  obj["b"] = Element(true);
+  obj["a"] = Element("x");
+  obj["b"] = Element(false);
+
+  // Entries keep their insertion order.
+  REQUIRE(obj.size() == 2);
+  REQUIRE(obj.begin()->first == "b");
+  REQUIRE(!obj.begin()->second.boolean());
+  REQUIRE(serialize(Element(obj)) == "{ \"b\": false, \"a\": \"x\" }");
+  REQUIRE(!obj.insert(Object::value_type("a", Element())).second);
+  REQUIRE(obj.at("a") == Element("x"));
+
+  // Large objects are found through the hash index.
+  for(int i = 0; i < 1000; ++i) {
+    obj["key" + std::to_string(i)] = Element(Integer(i));
+  }
+  REQUIRE(obj.erase("key10") == 1);
+  REQUIRE(obj.erase("key10") == 0);
+  REQUIRE(obj.size() == 1001);
+  for(int i = 0; i < 1000; ++i) {
+    REQUIRE(obj.count("key" + std::to_string(i)) == (i != 10));
+  }
+  REQUIRE(obj.find("key999")->second.integer() == 999);
+  REQUIRE(obj.find("missing") == obj.end());
+
+  // Equality does not depend on the order.
+  Object reversed;
+  for(Object::const_iterator it = obj.end(); it != obj.begin();) {
+    --it;
+    reversed.insert(*it);
+  }
+  REQUIRE(reversed == obj);
+  reversed["a"] = Element("y");
+  REQUIRE(reversed != obj);
+
+  try {
+    obj.at("missing");
+    FAIL("Expected missing key to throw.");
+  }
+  catch (std::out_of_range &e) {
+  }
+}
+
+TEST_CASE("Object keys", "[core] [json]") {
+  Key key("name");
+  Key copy = key;
+  REQUIRE(&copy.str() == &key.str());
+  REQUIRE(copy == Key(String("name")));
+  REQUIRE(key == "name");
+  REQUIRE(String("name") == key);
+  REQUIRE(Key() == "");
+
+  // Interned names share one key for the life of the process.
+  REQUIRE(&Key::intern("field").str() == &Key::intern("field").str());
+
+  // Repeated keys of a document share their text.
+  Element doc = deserialize("[{\"id\": 1, \"name\": \"a\"}, {\"id\": 2, \"name\": \"b\"}]");
+  const Object &first = doc.array()[0].object();
+  const Object &second = doc.array()[1].object();
+  REQUIRE(&first.begin()->first.str() == &second.begin()->first.str());
+  REQUIRE(first.find(String("name")) != first.end());
+  REQUIRE(first.find(Key("name"))->second == Element("a"));
+}
+
+TEST_CASE("Element shared copies", "[core] [json]") {
+  Element doc = deserialize("{\"list\": [1, 2, 3], \"name\": \"text\"}");
+  Element copy = doc;
+  const Element &constDoc = doc;
+  const Element &constCopy = copy;
+
+  // Copies share their payload until one of them changes.
+  REQUIRE(&constCopy.object() == &constDoc.object());
+  REQUIRE(copy == doc);
+
+  copy.object()["list"].array().push_back(Element(Integer(4)));
+  REQUIRE(&constCopy.object() != &constDoc.object());
+  REQUIRE(constDoc.object().at("list").array().size() == 3);
+  REQUIRE(constCopy.object().at("list").array().size() == 4);
+
+  // Children that were not changed are still shared.
+  REQUIRE(&constDoc.object().at("name").str() == &constCopy.object().at("name").str());
+
+  // A payload whose mutable reference was handed out is copied, as the reference may still be used.
+  Element array(Element::ARRAY);
+  Array &items = array.array();
+  Element arrayCopy = array;
+  items.push_back(Element(Integer(1)));
+  REQUIRE(array.array().size() == 1);
+  REQUIRE(arrayCopy.array().empty());
+
+  // Appending keeps the payload shareable.
+  Element built(Element::OBJECT);
+  built.set(Key("a"), Element(Integer(1)));
+  Element builtCopy = built;
+  REQUIRE(&static_cast<const Element&>(builtCopy).object() == &static_cast<const Element&>(built).object());
+}
@@ -0,0 +1,63 @@
+#include "../catch.hpp"
+#include "json.hpp"
+#include <sstream>
+
+using namespace xyz::json;
+
+namespace {
+  class RecordingHandler: public Handler {
+  public:
+    void onNull() { events += "null "; }
+    void onBoolean(Boolean value) { events += value ? "true " : "false "; }
+    void onNumber(Number value) { events += serialize(Element(value)) + " "; }
+    void onString(const String &value) { events += "\"" + value + "\" "; }
+    void onKey(const String &key) { events += key + ": "; }
+    void onStartObject() { events += "{ "; }
+    void onEndObject() { events += "} "; }
+    void onStartArray() { events += "[ "; }
+    void onEndArray() { events += "] "; }
+
+    String events;
+  };
+
+  class SumHandler: public Handler {
+  public:
+    SumHandler():sum(0) {}
+
+    void onNumber(Number value) { sum += value; }
+
+    Number sum;
+  };
+}
+
+TEST_CASE("Parse events", "[core] [json]") {
+  RecordingHandler handler;
+  parse("{\"a\": [1, \"x\", null], \"b\": {\"c\": true}, \"d\": []}", handler);
+  REQUIRE(handler.events == "{ a: [ 1 \"x\" null ] b: { c: true } d: [ ] } ");
+}
+
+TEST_CASE("Parse events primitive root", "[core] [json]") {
+  RecordingHandler handler;
+  parse(" false // comment", handler);
+  REQUIRE(handler.events == "false ");
+}
+
+TEST_CASE("Parse events default handler", "[core] [json]") {
+  SumHandler handler;
+  std::istringstream stream("[1, {\"x\": 2.5, \"y\": [\"3\", 4]}]");
+  parse(stream, handler);
+  REQUIRE(handler.sum == 7.5);
+}
+
+TEST_CASE("Parse events error", "[core] [json]") {
+  RecordingHandler handler;
+  try {
+    parse("[1,\n2}", handler);
+    FAIL("Expected mismatched bracket to throw.");
+  }
+  catch(const SyntaxError &e) {
+    REQUIRE(e.line == 2);
+    REQUIRE(e.chr == '}');
+  }
+  REQUIRE(handler.events == "[ 1 2 ");
+}
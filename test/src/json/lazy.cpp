@@ -0,0 +1,253 @@
+#include "../catch.hpp"
+#include "json.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+
+using namespace xyz::json;
+
+namespace {
+  bool lazySyntaxError(const String &text) {
+    LazyDocument doc;
+    try {
+      deserialize(text.data(), text.size(), doc);
+    }
+    catch (SyntaxError &e) {
+      return true;
+    }
+    return false;
+  }
+
+  Element walk(const LazyDocument::Value &value) {
+    // Copy value through the lazy iterators, rather than toElement which runs the parser.
+    if(value.isArray()) {
+      Element array(Element::ARRAY);
+      LazyDocument::Array elements = value.array();
+      for(LazyDocument::Array::const_iterator it = elements.begin(); it != elements.end(); ++it) {
+        array.append(walk(*it));
+      }
+      return array;
+    }
+    if(value.isObject()) {
+      Element object(Element::OBJECT);
+      LazyDocument::Object entries = value.object();
+      for(LazyDocument::Object::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        object.set(it->first.str(), walk(it->second));
+      }
+      return object;
+    }
+    return value.toElement();
+  }
+}
+
+TEST_CASE("Lazy deserialize", "[core] [json]") {
+  LazyDocument doc;
+  REQUIRE(doc.root().isNull());
+
+  String text = "{\"name\": \"con\\\"fig\", \"size\": 3, \"big\": 18446744073709551615, \"ratio\": 0.5,\n"
+                " \"flags\": [true, false, null], \"nested\": {\"empty\": {}, \"list\": [[], [1, \"]\"]]},\n"
+                " \"esc\\u0061ped\": \"a\\u0000b\" // comment\n"
+                "}";
+  deserialize(text.data(), text.size(), doc);
+
+  LazyDocument::Value root = doc.root();
+  REQUIRE(root.isObject());
+  REQUIRE(root.toElement() == deserialize(text));
+
+  LazyDocument::Object object = root.object();
+  REQUIRE(object.size() == 7);
+  REQUIRE(object.begin()->first.str() == "name");
+  REQUIRE(object["name"].str() == "con\"fig");
+  REQUIRE(object.at("size").integer() == 3);
+  REQUIRE(object["big"].unsignedInteger() == 18446744073709551615ULL);
+  REQUIRE(object["ratio"].number() == 0.5);
+  REQUIRE(object["escaped"].str() == String("a\0b", 3));
+  REQUIRE(object.find("missing") == object.end());
+  REQUIRE(object.count("nested") == 1);
+
+  LazyDocument::Array flags = object["flags"].array();
+  REQUIRE(flags.size() == 3);
+  REQUIRE(flags[0].boolean());
+  REQUIRE(!flags[1].boolean());
+  REQUIRE(flags[2].isNull());
+
+  LazyDocument::Value nested = object["nested"];
+  REQUIRE(nested.object()["empty"].object().empty());
+  REQUIRE(nested.object()["list"].array()[0].array().empty());
+  REQUIRE(nested.object()["list"].array()[1].array()[1].str() == "]");
+  REQUIRE(serialize(nested.toElement()) == "{ \"empty\": {}, \"list\": [ [], [ 1, \"]\" ] ] }");
+
+  try {
+    object["name"].number();
+    FAIL("Expected string to throw as number.");
+  }
+  catch (TypeError &e) {
+  }
+
+  try {
+    flags.at(3);
+    FAIL("Expected index past the end to throw.");
+  }
+  catch (std::out_of_range &e) {
+  }
+
+  text = "12";
+  deserialize(text.data(), text.size(), doc);
+  REQUIRE(doc.root().integer() == 12);
+}
+
+TEST_CASE("Lazy deserialize errors", "[core] [json]") {
+  // Brackets and the number of values are checked up front.
+  REQUIRE(lazySyntaxError(""));
+  REQUIRE(lazySyntaxError("[1, 2"));
+  REQUIRE(lazySyntaxError("[1, 2}"));
+  REQUIRE(lazySyntaxError("{\"a\": 1]"));
+  REQUIRE(lazySyntaxError("{} 1"));
+  REQUIRE(lazySyntaxError("]"));
+  REQUIRE(lazySyntaxError("\"open"));
+
+  // Anything else once the value is read.
+  LazyDocument doc;
+  String text = "{\"skipped\": [1, 2 3, tru],\n \"bad\": nul, \"list\": [1,]}";
+  deserialize(text.data(), text.size(), doc);
+  LazyDocument::Object object = doc.root().object();
+  REQUIRE(object.count("list") == 1);
+
+  try {
+    object["bad"].isNull();
+    object["bad"].toElement();
+    FAIL("Expected malformed literal to throw.");
+  }
+  catch (SyntaxError &e) {
+    REQUIRE(e.line == 2);
+  }
+
+  REQUIRE(object["list"].array().size() == 1);
+
+  try {
+    object["skipped"].array().size();
+    FAIL("Expected missing comma to throw.");
+  }
+  catch (SyntaxError &e) {
+  }
+}
+
+TEST_CASE("Lazy large document", "[core] [json]") {
+  String text = "{\"records\": [";
+  for(int i = 0; i < 20000; ++i) {
+    text += i ? ", " : "";
+    text += "{\"id\": " + std::to_string(i) + ", \"tags\": [\"a\", \"b\", {\"c\": [1, 2, 3]}]}";
+  }
+  text += "], \"version\": 7}";
+
+  LazyDocument doc;
+  deserialize(text.data(), text.size(), doc);
+  REQUIRE(doc.root().object()["version"].integer() == 7);
+
+  Integer sum = 0;
+  LazyDocument::Array records = doc.root().object()["records"].array();
+  for(LazyDocument::Array::const_iterator it = records.begin(); it != records.end(); ++it) {
+    sum += it->object().begin()->second.integer();
+  }
+  REQUIRE(sum == 19999 * 20000 / 2);
+  REQUIRE(doc.root().toElement() == deserialize(text));
+}
+
+TEST_CASE("Lazy load", "[core] [json]") {
+  const char *path = "xyz_reflect_lazy_load.json";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "{\"name\": \"plain\", \"escaped\": \"tab\\there\", \"list\": [1, 2, 3]}";
+  }
+
+  LazyDocument doc;
+  load(path, doc);
+  std::remove(path);
+
+  LazyDocument::Object object = doc.root().object();
+  StringView plain = object["name"].view();
+  REQUIRE(plain == "plain");
+  REQUIRE(plain.str() == "plain");
+  REQUIRE(object.begin()->first.view() == String("name"));
+  REQUIRE(object["escaped"].view() == "tab\there");
+  REQUIRE(object["list"].array().size() == 3);
+
+  try {
+    object["list"].view();
+    FAIL("Expected array to throw as string.");
+  }
+  catch (TypeError &e) {
+  }
+
+  try {
+    load("xyz_reflect_missing.json", doc);
+    FAIL("Expected missing file to throw.");
+  }
+  catch (std::system_error &e) {
+  }
+  REQUIRE(doc.root().isNull());
+}
+
+TEST_CASE("Lazy scalars", "[core] [json]") {
+  LazyDocument doc;
+  String text = "[\"tab\\there\", \"plain\" // comment\n, -12, 1e3, true, nullx, \"end\"x]";
+  deserialize(text.data(), text.size(), doc);
+  LazyDocument::Array array = doc.root().array();
+
+  // Escaped strings are decoded once, plain ones are read in place.
+  StringView escaped = array[0].view();
+  REQUIRE(escaped == "tab\there");
+  REQUIRE(array[0].view().data() == escaped.data());
+  REQUIRE(array[0].str() == "tab\there");
+  REQUIRE(array[1].view().data() == text.data() + 15);
+
+  REQUIRE(array[2].integer() == -12);
+  REQUIRE(array[2].toElement().isInteger());
+  REQUIRE(array[3].number() == 1000.0);
+  REQUIRE(array[4].boolean());
+
+  try {
+    array[5].toElement();
+    FAIL("Expected trailing characters after literal to throw.");
+  }
+  catch (SyntaxError &e) {
+  }
+
+  try {
+    array[6].view();
+    FAIL("Expected trailing characters after string to throw.");
+  }
+  catch (SyntaxError &e) {
+  }
+}
+
+TEST_CASE("Lazy trailing commas", "[core] [json]") {
+  // Containers are read like the parser reads them.
+  const char *accepted[] = { "[1,]", "{\"a\": 1,}", "[[], {},]", "{\"a\": {\"b\": [1, ],\n }, }" };
+  for(std::size_t i = 0; i < sizeof(accepted) / sizeof(accepted[0]); ++i) {
+    String text = accepted[i];
+    LazyDocument doc;
+    deserialize(text.data(), text.size(), doc);
+    REQUIRE(walk(doc.root()) == deserialize(text));
+  }
+
+  const char *rejected[] = { "[,]", "{,}", "[1,,]", "{\"a\": 1,,}" };
+  for(std::size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); ++i) {
+    String text = rejected[i];
+    LazyDocument doc;
+    deserialize(text.data(), text.size(), doc);
+    try {
+      walk(doc.root());
+      FAIL("Expected lazy read to throw: " << text);
+    }
+    catch (SyntaxError &e) {
+    }
+    try {
+      deserialize(text);
+      FAIL("Expected parse to throw: " << text);
+    }
+    catch (SyntaxError &e) {
+    }
+  }
+}
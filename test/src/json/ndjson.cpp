@@ -0,0 +1,175 @@
+#include "../catch.hpp"
+#include "json.hpp"
+#include <sstream>
+#include <atomic>
+
+using namespace xyz::json;
+
+TEST_CASE("Reader buffer", "[core] [json]") {
+  String input = "{\"id\": 1}\n[true, null]\n\"text\"\n42\n";
+
+  Reader reader(input.data(), input.size());
+  Element el;
+
+  REQUIRE(reader.next(el));
+  REQUIRE(el == deserialize("{\"id\": 1}"));
+  REQUIRE(reader.next(el));
+  REQUIRE(el == deserialize("[true, null]"));
+  REQUIRE(reader.next(el));
+  REQUIRE(el == Element("text"));
+  REQUIRE(reader.next(el));
+  REQUIRE(el == Element(Number(42)));
+  REQUIRE(!reader.next(el));
+  REQUIRE(!reader.next(el));
+}
+
+TEST_CASE("Reader stream", "[core] [json]") {
+  std::ostringstream os;
+  for(int i = 0; i < 10000; ++i) {
+    os << "{\"id\": " << i << ", \"tags\": [\"a\", \"b\"]}\r\n";
+  }
+  os << "// no more documents\n";
+
+  std::istringstream stream(os.str());
+  Reader reader(stream);
+  Element el;
+  int count = 0;
+  while(reader.next(el)) {
+    REQUIRE(el.object()["id"].number() == count);
+    ++count;
+  }
+  REQUIRE(count == 10000);
+}
+
+TEST_CASE("Reader stream long string", "[core] [json]") {
+  // Strings spanning many stream blocks are read on from where each block ended, between other documents.
+  String text;
+  for(int i = 0; i < 200000; ++i) {
+    text += "ab\\\"\\u00e4\xe2\x82\xac ";
+  }
+  String input = "{\"text\": \"" + text + "\", \"id\": 1}\n\"" + text + "\"\n[2]\n";
+
+  std::istringstream stream(input);
+  Reader reader(stream);
+  Element el;
+  REQUIRE(reader.next(el));
+  REQUIRE(el == deserialize("{\"text\": \"" + text + "\", \"id\": 1}"));
+  REQUIRE(reader.next(el));
+  REQUIRE(el == deserialize("\"" + text + "\""));
+  REQUIRE(reader.next(el));
+  REQUIRE(el == deserialize("[2]"));
+  REQUIRE(!reader.next(el));
+}
+
+TEST_CASE("Reader events", "[core] [json]") {
+  class CountingHandler: public Handler {
+  public:
+    CountingHandler():objects(0) {}
+    void onStartObject() { ++objects; }
+    int objects;
+  };
+
+  std::istringstream stream("{} {\"a\": {}}\n[]");
+  Reader reader(stream);
+  CountingHandler handler;
+  REQUIRE(reader.next(handler));
+  REQUIRE(handler.objects == 1);
+  REQUIRE(reader.next(handler));
+  REQUIRE(handler.objects == 3);
+  REQUIRE(reader.next(handler));
+  REQUIRE(!reader.next(handler));
+}
+
+TEST_CASE("Reader empty", "[core] [json]") {
+  std::istringstream stream(" \n ");
+  Reader reader(stream);
+  Element el;
+  REQUIRE(!reader.next(el));
+}
+
+TEST_CASE("Reader error", "[core] [json]") {
+  String input = "[1]\n[2]\n[3 4]\n";
+  Reader reader(input.data(), input.size());
+  Element el;
+  REQUIRE(reader.next(el));
+  REQUIRE(reader.next(el));
+
+  try {
+    reader.next(el);
+    FAIL("Expected missing comma to throw.");
+  }
+  catch(const SyntaxError &e) {
+    REQUIRE(e.line == 3);
+    REQUIRE(e.chr == '4');
+  }
+}
+
+TEST_CASE("Writer", "[core] [json]") {
+  std::ostringstream os;
+  {
+    Writer writer(os);
+    writer.write(deserialize("{\"a\": [1, 2]}"));
+    writer.write(Element("line\nbreak"));
+    writer.write(Element(Number(3)));
+  }
+  REQUIRE(os.str() == "{ \"a\": [ 1, 2 ] }\n\"line\\nbreak\"\n3\n");
+
+  std::istringstream stream(os.str());
+  Reader reader(stream);
+  Element el;
+  REQUIRE(reader.next(el));
+  REQUIRE(reader.next(el));
+  REQUIRE(el == Element("line\nbreak"));
+  REQUIRE(reader.next(el));
+  REQUIRE(!reader.next(el));
+}
+
+TEST_CASE("Deserialize lines in parallel", "[core] [json]") {
+  std::ostringstream os;
+  for(int i = 0; i < 50000; ++i) {
+    os << "{\"id\": " << i << ", \"name\": \"entity " << i << "\"}\n";
+  }
+  String input = os.str();
+
+  Array documents = deserializeLines(input.data(), input.size(), 4);
+  REQUIRE(documents.size() == 50000);
+  bool ordered = true;
+  for(int i = 0; i < 50000; ++i) {
+    ordered = ordered && documents[i].object()["id"].number() == i;
+  }
+  REQUIRE(ordered);
+
+  REQUIRE(deserializeLines(input.data(), input.size(), 1).size() == 50000);
+  REQUIRE(deserializeLines(input.data(), 0).empty());
+}
+
+TEST_CASE("Deserialize lines callback", "[core] [json]") {
+  std::ostringstream os;
+  for(int i = 0; i < 50000; ++i) {
+    os << "[" << i << "]\n";
+  }
+  String input = os.str();
+
+  std::atomic<long> sum(0);
+  deserializeLines(input.data(), input.size(), [&](Element &document) {
+    sum += long(document.array()[0].number());
+  }, 4);
+  REQUIRE(sum == 49999L * 50000L / 2);
+}
+
+TEST_CASE("Deserialize lines error", "[core] [json]") {
+  std::ostringstream os;
+  for(int i = 0; i < 50000; ++i) {
+    os << (i == 40000 ? "{\"id\" 1}" : "{\"id\": 1}") << "\n";
+  }
+  String input = os.str();
+
+  try {
+    deserializeLines(input.data(), input.size(), 4);
+    FAIL("Expected missing separator to throw.");
+  }
+  catch(const SyntaxError &e) {
+    REQUIRE(e.line == 40001);
+    REQUIRE(e.chr == '1');
+  }
+}
@@ -0,0 +1,136 @@
+#include "../catch.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <sstream>
+
+using namespace xyz::json;
+
+TEST_CASE("Parser feed single bytes", "[core] [json]") {
+  String input = "{ \"list\": [1.5, -20, true, null], // comment\n \"text\": \"a\\\"b\\u0041\\ud83c\\udf89 \xc3\xa4\" }";
+
+  Element el;
+  Parser parser(el);
+  for(std::size_t i = 0; i + 1 < input.size(); ++i) {
+    REQUIRE(parser.feed(&input[i], 1) == Parser::INCOMPLETE);
+  }
+  REQUIRE(parser.feed(&input[input.size() - 1], 1) == Parser::COMPLETE);
+  parser.finish();
+
+  REQUIRE(el == deserialize(input));
+}
+
+TEST_CASE("Parser feed chunks", "[core] [json]") {
+  Element el;
+  Parser parser(el);
+  REQUIRE(parser.feed("[12") == Parser::INCOMPLETE);
+  REQUIRE(parser.feed("34, \"ab") == Parser::INCOMPLETE);
+  REQUIRE(parser.feed("cd\", fal") == Parser::INCOMPLETE);
+  REQUIRE(parser.feed("se]  ") == Parser::COMPLETE);
+  REQUIRE(parser.feed("// trailing") == Parser::COMPLETE);
+  parser.finish();
+
+  REQUIRE(el == deserialize("[1234, \"abcd\", false]"));
+}
+
+TEST_CASE("Parser feed long string", "[core] [json]") {
+  // Strings spanning many chunks are resumed where the last chunk ended, however their escapes and
+  // UTF-8 sequences are split. Reading them again for every chunk would take far too long here.
+  String text;
+  for(int i = 0; i < 25000; ++i) {
+    text += "abc\\n\\u00e4\\ud83c\\udf89\xc3\xa4\xe2\x82\xac ";
+  }
+  String input = "{\"" + text + "\": [\"" + text + "\"]}";
+
+  Element el;
+  Parser parser(el);
+  std::size_t chunk = 1;
+  for(std::size_t i = 0; i < input.size(); i += chunk, chunk = chunk % 61 + 1) {
+    parser.feed(&input[i], std::min(chunk, input.size() - i));
+  }
+  parser.finish();
+
+  REQUIRE(el == deserialize(input));
+
+  String invalid = "[\"" + String(1 << 20, 'x') + "\xc3\x28\"]";
+  Parser failing(el);
+  try {
+    for(std::size_t i = 0; i < invalid.size(); i += 1000) {
+      failing.feed(&invalid[i], std::min<std::size_t>(1000, invalid.size() - i));
+    }
+    failing.finish();
+    FAIL("Expected invalid UTF-8 to throw.");
+  }
+  catch(const SyntaxError &e) {
+    REQUIRE(e.msg == String("Invalid UTF-8 in string."));
+  }
+}
+
+TEST_CASE("Parser primitive root", "[core] [json]") {
+  Element el;
+  Parser parser(el);
+  REQUIRE(parser.feed("-4") == Parser::INCOMPLETE);
+  REQUIRE(parser.feed("2") == Parser::INCOMPLETE);
+  parser.finish();
+
+  REQUIRE(el == Element(Number(-42)));
+}
+
+TEST_CASE("Parser events", "[core] [json]") {
+  class CountingHandler: public Handler {
+  public:
+    CountingHandler():count(0) {}
+    void onNumber(Number value) { ++count; }
+    int count;
+  };
+
+  CountingHandler handler;
+  Parser parser(handler);
+  parser.feed("[1, 2");
+  REQUIRE(handler.count == 1);
+  parser.feed(", 3]");
+  REQUIRE(handler.count == 3);
+  parser.finish();
+}
+
+TEST_CASE("Parser errors", "[core] [json]") {
+  Element el;
+  Parser parser(el);
+  parser.feed("[\n1,\n");
+
+  try {
+    parser.feed("2 3]");
+    FAIL("Expected missing comma to throw.");
+  }
+  catch(const SyntaxError &e) {
+    REQUIRE(e.line == 3);
+    REQUIRE(e.chr == '3');
+  }
+
+  Parser truncated(el);
+  truncated.feed("{\"a\": [");
+
+  try {
+    truncated.finish();
+    FAIL("Expected incomplete document to throw.");
+  }
+  catch(const SyntaxError &e) {
+    REQUIRE(e.msg == String("Unexpected end of file."));
+    REQUIRE(e.chr == '[');
+  }
+}
+
+TEST_CASE("Parser large stream", "[core] [json]") {
+  std::ostringstream os;
+  os << "[";
+  for(int i = 0; i < 20000; ++i) {
+    os << (i ? ", " : "") << "{\"id\": " << i << ", \"name\": \"item " << i << "\"}";
+  }
+  os << "]";
+
+  std::istringstream stream(os.str());
+  Element el;
+  deserialize(stream, el);
+
+  REQUIRE(el.array().size() == 20000);
+  REQUIRE(el.array()[19999].object()["name"].str() == "item 19999");
+}
@@ -0,0 +1,82 @@
+#include "../catch.hpp"
+#include "json.hpp"
+
+#include <stdexcept>
+
+using namespace xyz::json;
+
+TEST_CASE("Deserialize projection", "[core] [json]") {
+  String text = "{\"version\": 3, \"name\": \"world // [\\\"x\\\"]\",\n"
+                " \"entities\": [\n"
+                "  {\"id\": 1, \"transform\": {\"pos\": [1, 2, 3]}, \"mesh\": {\"lod\": [[0], [1, {}]]}},\n"
+                "  {\"id\": 2, \"mesh\": \"rock\"}, // comment with ] and }\n"
+                "  {\"id\": 3, \"transform\": null}\n"
+                " ],\n"
+                " \"a/b\": {\"~\": true, \"c\": false}}";
+
+  REQUIRE(deserialize(text, Projection{""}) == deserialize(text));
+  REQUIRE(deserialize(text, Projection{"/version"}) == deserialize("{\"version\": 3}"));
+  REQUIRE(deserialize(text, Projection{"/missing"}) == deserialize("{}"));
+  REQUIRE(deserialize(text, Projection()).isNull());
+
+  REQUIRE(deserialize(text, Projection{"/entities/*/transform"}) ==
+          deserialize("{\"entities\": [{\"transform\": {\"pos\": [1, 2, 3]}}, {}, {\"transform\": null}]}"));
+
+  // Unselected array elements are kept as null, so indices stay the same.
+  REQUIRE(deserialize(text, Projection{"/entities/2/id", "/version"}) ==
+          deserialize("{\"entities\": [null, null, {\"id\": 3}], \"version\": 3}"));
+
+  // Primitives are not entered by longer paths.
+  REQUIRE(deserialize(text, Projection{"/entities/*/mesh/lod/1", "/name/x"}) ==
+          deserialize("{\"entities\": [{\"mesh\": {\"lod\": [null, [1, {}]]}}, {}, {}]}"));
+
+  REQUIRE(deserialize(text, Projection{"/a~1b/~0"}) == deserialize("{\"a/b\": {\"~\": true}}"));
+
+  // Overlapping paths select the larger value.
+  REQUIRE(deserialize(text, Projection{"/entities/0", "/entities/*/id"}) ==
+          deserialize("{\"entities\": [" + serialize(deserialize(text).object()["entities"].array()[0]) +
+                      ", {\"id\": 2}, {\"id\": 3}]}"));
+
+  try {
+    Projection{"entities"};
+    FAIL("Expected pointer without leading '/' to throw.");
+  }
+  catch (std::invalid_argument &e) {
+  }
+
+  try {
+    Projection{"/a~2"};
+    FAIL("Expected invalid escape to throw.");
+  }
+  catch (std::invalid_argument &e) {
+  }
+}
+
+TEST_CASE("Deserialize projection errors", "[core] [json]") {
+  const char *inputs[] = {
+    "{\"skip\": [1, 2", "{\"skip\": \"open", "{\"skip\": , \"keep\": 1}", "{\"keep\" 1}", "{\"skip\": {}} x",
+    "{\"skip\": [1}, \"keep\": 1}", "{\"skip\": [1, 2}, \"keep\": 1}", "{\"skip\": {\"a\": [{]}}, \"keep\": 1}"
+  };
+  for(std::size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+    try {
+      deserialize(inputs[i], Projection{"/keep"});
+      FAIL(inputs[i]);
+    }
+    catch (SyntaxError &e) {
+    }
+  }
+
+  // Brackets are matched past the levels held in a single word too.
+  String deep = "{\"skip\": " + String(70, '[') + "{]" + String(69, ']') + ", \"keep\": 1}";
+  try {
+    deserialize(deep, Projection{"/keep"});
+    FAIL("Expected mismatched deep bracket to throw.");
+  }
+  catch (SyntaxError &e) {
+  }
+  deep = "{\"skip\": " + String(70, '[') + "{}" + String(70, ']') + ", \"keep\": 1}";
+  REQUIRE(deserialize(deep, Projection{"/keep"}) == deserialize("{\"keep\": 1}"));
+
+  // Skipped values are only checked for strings and matching brackets.
+  REQUIRE(deserialize("{\"skip\": [tru, 1 2], \"keep\": 1}", Projection{"/keep"}) == deserialize("{\"keep\": 1}"));
+}
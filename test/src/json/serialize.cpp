@@ -1,5 +1,8 @@
 #include "../catch.hpp"
 #include "json.hpp"
+#include <limits>
+#include <sstream>
+#include <cmath>
 
 using namespace xyz::json;
 
@@ -55,6 +58,88 @@ TEST_CASE("Serialize object", "[core] [json]") {
   REQUIRE(serialize(el, false) == "{ \"arr\": [] }");
 }
 
+TEST_CASE("Serialize nested indent", "[core] [json]") {
+  Element el = deserialize("{\"a\": [1, {\"b\": [true]}]}");
+
+  REQUIRE(serialize(el, true) == "{\n  \"a\": [\n    1,\n    {\n      \"b\": [\n        true\n      ]\n    }\n  ]\n}");
+  REQUIRE(serialize(el, false) == "{ \"a\": [ 1, { \"b\": [ true ] } ] }");
+
+  // Deeper than the shared run of indentation spaces.
+  Element deep = Element(Element::ARRAY);
+  for(int i = 0; i < 40; ++i) {
+    Array wrapper;
+    wrapper.push_back(deep);
+    deep = Element(std::move(wrapper));
+  }
+  REQUIRE(deserialize(serialize(deep, true)) == deep);
+  REQUIRE(serialize(deep, true).find(String(80, ' ') + "[]") != String::npos);
+}
+
+TEST_CASE("Serialize to buffer", "[core] [json]") {
+  Element el = deserialize("[1, \"two\", null]");
+  String expected = "[ 1, \"two\", null ]";
+
+  String str = "prefix ";
+  serialize(str, el);
+  REQUIRE(str == "prefix " + expected);
+
+  char buffer[64];
+  REQUIRE(serialize(buffer, sizeof(buffer), el) == expected.size());
+  REQUIRE(String(buffer, expected.size()) == expected);
+
+  char small[5] = {'x', 'x', 'x', 'x', 'x'};
+  REQUIRE(serialize(small, 4, el) == expected.size());
+  REQUIRE(String(small, 5) == "[ 1,x");
+}
+
+TEST_CASE("Serialize stream", "[core] [json]") {
+  Array ar;
+  for(int i = 0; i < 5000; ++i) {
+    ar.push_back(Element("some text to fill more than one output block"));
+  }
+  Element el(ar);
+
+  std::ostringstream os;
+  serialize(os, el, true);
+  REQUIRE(os.str() == serialize(el, true));
+}
+
+TEST_CASE("Serialize UTF-8", "[core] [json]") {
+  // "Grüße, 世界 🎉"
+  String text = "Gr\xc3\xbc\xc3\x9f" "e, \xe4\xb8\x96\xe7\x95\x8c \xf0\x9f\x8e\x89";
+
+  REQUIRE(serialize(Element(text)) == "\"" + text + "\"");
+  REQUIRE(serialize(Element(text), ASCII) == "\"Gr\\u00fc\\u00dfe, \\u4e16\\u754c \\ud83c\\udf89\"");
+
+  REQUIRE(deserialize(serialize(Element(text))) == Element(text));
+  REQUIRE(deserialize(serialize(Element(text), ASCII)) == Element(text));
+
+  // Bytes which are not valid UTF-8 are escaped as Latin-1, whatever follows them.
+  REQUIRE(serialize(Element("\xc4")) == "\"\\u00c4\"");
+  REQUIRE(serialize(Element("a\xe4\xb8z")) == "\"a\\u00e4\\u00b8z\"");
+  REQUIRE(serialize(Element("\xc0\x80")) == "\"\\u00c0\\u0080\"");
+  REQUIRE(serialize(Element("\xed\xa0\x80")) == "\"\\u00ed\\u00a0\\u0080\"");
+  REQUIRE(serialize(Element("\x7f\x01")) == "\"\\u007f\\u0001\"");
+}
+
+TEST_CASE("Serialize long string", "[core] [json]") {
+  String text, expected;
+  for(int i = 0; i < 100; ++i) {
+    text += "plain text run \xc3\xa4 \"quoted\"\t";
+    expected += "plain text run \xc3\xa4 \\\"quoted\\\"\\t";
+  }
+
+  REQUIRE(serialize(Element(text)) == "\"" + expected + "\"");
+}
+
+TEST_CASE("Serialize escaped key", "[core] [json]") {
+  Object obj;
+  obj["a\"b"] = Number(1);
+
+  REQUIRE(serialize(Element(obj)) == "{ \"a\\\"b\": 1 }");
+  REQUIRE(deserialize(serialize(Element(obj))) == Element(obj));
+}
+
 // TODO: Negative tests.
 
 TEST_CASE("Deserialize empty", "[core] [json]") {
@@ -85,27 +170,49 @@ TEST_CASE("Deserialize object", "[core] [json]") {
 TEST_CASE("Deserialize string", "[core] [json]") {
   REQUIRE(deserialize("\"<\\\" \\\\>\"") == Element("<\" \\>"));
   REQUIRE(deserialize("\"\\u0000\"") == Element(String(1, '\0')));
-  REQUIRE(deserialize("\"\\u00c4\"") == Element(String(1, '\xc4')));
-  REQUIRE(deserialize("\"\\u00C4\"") == Element(String(1, '\xc4')));
-  REQUIRE(deserialize("\"\xc4\"") == Element(String(1, '\xc4')));
+  REQUIRE(deserialize("\"\\u00c4\"") == Element("\xc3\x84"));
+  REQUIRE(deserialize("\"\\u00C4\"") == Element("\xc3\x84"));
+  REQUIRE(deserialize("\"\\u0100\"") == Element("\xc4\x80"));
+  REQUIRE(deserialize("\"\\u4e16\\u754c\"") == Element("\xe4\xb8\x96\xe7\x95\x8c"));
+  REQUIRE(deserialize("\"\\ud83c\\udf89\"") == Element("\xf0\x9f\x8e\x89"));
+  REQUIRE(deserialize("\"\xc3\x84\x7f \xf0\x9f\x8e\x89\"") == Element("\xc3\x84\x7f \xf0\x9f\x8e\x89"));
 
   try {
-    deserialize("\"\\u0100\"");
+    deserialize("\"\\ud83c x\"");
 
-    FAIL("Expected exception on multi-byte escape sequence");
+    FAIL("Expected exception on unpaired surrogate");
   }
-  catch (SyntaxError e) {
-    REQUIRE(String(e.msg) == "Escape sequence above Latin-1 not implemented.");
+  catch (const SyntaxError &e) {
+    REQUIRE(String(e.msg) == "Invalid surrogate pair in escape sequence.");
     REQUIRE(e.line == 1);
   }
 
+  try {
+    deserialize("\"\\udf89\"");
+
+    FAIL("Expected exception on unpaired low surrogate");
+  }
+  catch (const SyntaxError &e) {
+    REQUIRE(String(e.msg) == "Invalid surrogate pair in escape sequence.");
+  }
+
+  try {
+    deserialize("\"ok \xc4\"");
+
+    FAIL("Expected exception on truncated UTF-8 sequence");
+  }
+  catch (const SyntaxError &e) {
+    REQUIRE(String(e.msg) == "Invalid UTF-8 in string.");
+    REQUIRE(e.chr == '\xc4');
+  }
+
   try {
     deserialize(String("\"") + String(1, '\x80') + String("\""));
 
-    FAIL("Expected exception on control character in string");
+    FAIL("Expected exception on stray continuation byte");
   }
-  catch (SyntaxError e) {
-    REQUIRE(String(e.msg) == "Control character in string.");
+  catch (const SyntaxError &e) {
+    REQUIRE(String(e.msg) == "Invalid UTF-8 in string.");
     REQUIRE(e.line == 1);
   }
 
@@ -114,7 +221,7 @@ TEST_CASE("Deserialize string", "[core] [json]") {
 
     FAIL("Expected exception on newline in string");
   }
-  catch (SyntaxError e) {
+  catch (const SyntaxError &e) {
     REQUIRE(String(e.msg) == "Control character in string.");
     REQUIRE(e.line == 1);
   }
@@ -124,7 +231,7 @@ TEST_CASE("Deserialize string", "[core] [json]") {
 
     FAIL("Expected exception on carriage return in string");
   }
-  catch (SyntaxError e) {
+  catch (const SyntaxError &e) {
     REQUIRE(String(e.msg) == "Control character in string.");
     REQUIRE(e.line == 1);
   }
@@ -141,8 +248,165 @@ TEST_CASE("Deserialize number", "[core] [json]") {
   REQUIRE(deserialize("12e-1") == Element(Number(1.2)));
 }
 
+TEST_CASE("Deserialize number exact", "[core] [json]") {
+  REQUIRE(deserialize("1e23").number() == 1e23);
+  REQUIRE(deserialize("5e-324").number() == 5e-324);
+  REQUIRE(deserialize("1.7976931348623157e308").number() == 1.7976931348623157e308);
+  REQUIRE(deserialize("2.2250738585072014e-308").number() == 2.2250738585072014e-308);
+  REQUIRE(deserialize("9007199254740993").number() == 9007199254740992.0);
+  REQUIRE(deserialize("3.14159265358979323846264338327950288").number() == 3.141592653589793);
+  REQUIRE(std::signbit(deserialize("-0").number()));
+
+  try {
+    deserialize("1e400");
+    FAIL("Expected out of range number to throw.");
+  }
+  catch(const SyntaxError &e) {
+    REQUIRE(e.chr == '1');
+  }
+
+  try {
+    deserialize("1.2.3");
+    FAIL("Expected malformed number to throw.");
+  }
+  catch(const SyntaxError &e) {
+    REQUIRE(e.chr == '1');
+  }
+}
+
+TEST_CASE("Deserialize integer", "[core] [json]") {
+  Element el = deserialize("9007199254740993");
+  REQUIRE(el.getNumberType() == Element::SIGNED_INTEGER);
+  REQUIRE(el.integer() == 9007199254740993);
+  REQUIRE(serialize(el) == "9007199254740993");
+
+  REQUIRE(deserialize("-9223372036854775808").integer() == std::numeric_limits<Integer>::min());
+  REQUIRE(deserialize("9223372036854775808").getNumberType() == Element::UNSIGNED_INTEGER);
+  REQUIRE(deserialize("18446744073709551615").unsignedInteger() == std::numeric_limits<UnsignedInteger>::max());
+
+  REQUIRE(deserialize("18446744073709551616").getNumberType() == Element::FLOATING_POINT);
+  REQUIRE(deserialize("-9223372036854775809").getNumberType() == Element::FLOATING_POINT);
+  REQUIRE(deserialize("1.0").getNumberType() == Element::FLOATING_POINT);
+  REQUIRE(deserialize("1e2").getNumberType() == Element::FLOATING_POINT);
+  REQUIRE(deserialize("-0").getNumberType() == Element::FLOATING_POINT);
+
+  REQUIRE(serialize(deserialize("[-1,18446744073709551615,0,-9223372036854775808]")) ==
+          "[ -1, 18446744073709551615, 0, -9223372036854775808 ]");
+}
+
+TEST_CASE("Serialize number", "[core] [json]") {
+  REQUIRE(serialize(Element(Number(123456789))) == "123456789");
+  REQUIRE(serialize(Element(Number(0.1))) == "0.1");
+  REQUIRE(serialize(Element(Number(3.141592653589793))) == "3.141592653589793");
+  REQUIRE(serialize(Element(Number(1e300))) == "1e+300");
+  REQUIRE(serialize(Element(Number(5e-324))) == "5e-324");
+  REQUIRE(serialize(Element(Number(-0.0))) == "-0");
+  REQUIRE(serialize(Element(Number(0.000123))) == "0.000123");
+  REQUIRE(Element(Number(-2.5)).toString() == "-2.5");
+}
+
+TEST_CASE("Serialize number shortest", "[core] [json]") {
+  REQUIRE(serialize(Element(Number(1e23))) == "1e+23");
+  REQUIRE(serialize(Element(Number(5e-324))) == "5e-324");
+  REQUIRE(serialize(Element(Number(9007199254740993.0))) == "9007199254740992");
+  REQUIRE(serialize(Element(Number(2.2250738585072014e-308))) == "2.2250738585072014e-308");
+  REQUIRE(serialize(Element(Number(2.2250738585072009e-308))) == "2.225073858507201e-308");
+  REQUIRE(serialize(Element(Number(1.7976931348623157e308))) == "1.7976931348623157e+308");
+  REQUIRE(serialize(Element(Number(8.41e21))) == "8.41e+21");
+}
+
+TEST_CASE("Serialize number round trip", "[core] [json]") {
+  Number value = 1;
+  for(int i = 0; i < 1000; ++i) {
+    value = value * -1.7320508075688772 + 0.5;
+    if(std::fabs(value) > 1e300) value = 1e-300 / value;
+
+    REQUIRE(deserialize(serialize(Element(value))).number() == value);
+  }
+}
+
 TEST_CASE("Deserialize line comment", "[core] [json]") {
   Array ar;
   ar.push_back(Element(Element::NULL_VALUE));
   REQUIRE(deserialize("// x\n [ null//\n]//") == Element(ar));
 }
+
+TEST_CASE("Deserialize buffer", "[core] [json]") {
+  // Input is not terminated after the given size.
+  const char data[] = "[1, \"two\"]garbage";
+  Element el = deserialize(data, 10);
+
+  REQUIRE(el.isArray());
+  REQUIRE(el.array().size() == 2);
+  REQUIRE(el.array()[0] == Element(Number(1)));
+  REQUIRE(el.array()[1] == Element("two"));
+
+  try {
+    deserialize(data, 4);
+
+    FAIL("Expected exception on truncated buffer");
+  }
+  catch (SyntaxError &e) {
+    REQUIRE(String(e.msg) == "Unexpected end of file.");
+  }
+}
+
+TEST_CASE("Deserialize stream", "[core] [json]") {
+  std::istringstream is("{ \"a\": [ true, null ] }");
+  Element el;
+  deserialize(is, el);
+
+  REQUIRE(serialize(el) == "{ \"a\": [ true, null ] }");
+  REQUIRE(is.eof());
+}
+
+TEST_CASE("Deserialize error line", "[core] [json]") {
+  try {
+    deserialize("{\n  \"a\": 1,\n  \"b\" 2\n}");
+
+    FAIL("Expected exception on missing separator");
+  }
+  catch (SyntaxError &e) {
+    REQUIRE(String(e.msg) == "Expected ':' separating key and value.");
+    REQUIRE(e.line == 3);
+    REQUIRE(e.chr == '2');
+  }
+}
+
+TEST_CASE("Deserialize large document", "[core] [json]") {
+  // Large enough to use the structural index, with escapes across block boundaries.
+  String doc = "[";
+  Array expected;
+  for(int i = 0; i < 500; ++i) {
+    String text = String(i % 70, ' ') + "\\\"" + String(i % 3, '\\') + "{x}";
+    String escaped;
+    for(String::size_type c = 0; c < text.size(); ++c) {
+      if(text[c] == '"' || text[c] == '\\') escaped += '\\';
+      escaped += text[c];
+    }
+    doc += (i ? ",\n" : "\n") + String(i % 40, ' ') + "\"" + escaped + "\" ,[ 1.5 ,{\"k\" :true}]";
+    expected.push_back(Element(text));
+    Array inner;
+    inner.push_back(Element(Number(1.5)));
+    Object obj;
+    obj["k"] = true;
+    inner.push_back(Element(obj));
+    expected.push_back(Element(inner));
+  }
+  doc += "\n]";
+
+  REQUIRE(deserialize(doc) == Element(expected));
+  REQUIRE(deserialize(doc + "  // comment \" [\n") == Element(expected));
+  REQUIRE(deserialize(String(5000, ' ') + "// comment \"\n" + doc) == Element(expected));
+
+  try {
+    deserialize(doc.substr(0, doc.size() - 2) + ",1x]");
+
+    FAIL("Expected exception on garbage after number");
+  }
+  catch (SyntaxError &e) {
+    REQUIRE(String(e.msg) == "Expected ',' or closing bracket.");
+    REQUIRE(e.chr == 'x');
+    REQUIRE(e.line == 501);
+  }
+}
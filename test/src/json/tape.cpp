@@ -0,0 +1,136 @@
+#include "../catch.hpp"
+#include "json.hpp"
+
+using namespace xyz::json;
+
+TEST_CASE("Tape deserialize", "[core] [json]") {
+  Tape tape;
+  REQUIRE(tape.root().isNull());
+
+  String text = "{\"name\": \"config\", \"size\": 3, \"big\": 18446744073709551615, \"ratio\": 0.5,"
+                " \"flags\": [true, false, null], \"nested\": {\"empty\": {}, \"list\": [[], [1]]},"
+                " \"text\": \"a\\u0000b\"}";
+  deserialize(text.data(), text.size(), tape);
+
+  Tape::Value root = tape.root();
+  REQUIRE(root.isObject());
+  REQUIRE(root.toElement() == deserialize(text));
+
+  Tape::Object object = root.object();
+  REQUIRE(object.size() == 7);
+  REQUIRE(object.begin()->first.str() == "name");
+  REQUIRE(object["name"].str() == "config");
+  REQUIRE(object.at("size").integer() == 3);
+  REQUIRE(object["size"].getNumberType() == Element::SIGNED_INTEGER);
+  REQUIRE(object["big"].unsignedInteger() == 18446744073709551615ULL);
+  REQUIRE(object["ratio"].number() == 0.5);
+  REQUIRE(object["text"].length() == 3);
+  REQUIRE(object["text"].str() == String("a\0b", 3));
+  REQUIRE(object.find("missing") == object.end());
+  REQUIRE(object.count("nested") == 1);
+
+  Tape::Array flags = object["flags"].array();
+  REQUIRE(flags.size() == 3);
+  REQUIRE(flags[0].boolean());
+  REQUIRE(!flags[1].boolean());
+  REQUIRE(flags[2].isNull());
+
+  Tape::Value nested = object["nested"];
+  REQUIRE(nested.object()["empty"].object().empty());
+  REQUIRE(nested.object()["list"].array()[0].array().empty());
+  REQUIRE(nested.object()["list"].array()[1].array()[0].integer() == 1);
+  REQUIRE(serialize(nested.toElement()) == "{ \"empty\": {}, \"list\": [ [], [ 1 ] ] }");
+
+  std::size_t count = 0;
+  for(Tape::Object::const_iterator it = object.begin(); it != object.end(); ++it) {
+    REQUIRE(root.toElement().object().count(it->first.str()) == 1);
+    ++count;
+  }
+  REQUIRE(count == 7);
+
+  try {
+    object["name"].number();
+    FAIL("Expected string to throw as number.");
+  }
+  catch (TypeError &e) {
+  }
+
+  try {
+    flags.at(3);
+    FAIL("Expected index past the end to throw.");
+  }
+  catch (std::out_of_range &e) {
+  }
+
+  // The tape is reused, and cleared by a syntax error.
+  text = "[1, 2";
+  try {
+    deserialize(text.data(), text.size(), tape);
+    FAIL("Expected syntax error.");
+  }
+  catch (SyntaxError &e) {
+  }
+  REQUIRE(tape.root().isNull());
+
+  text = "\"scalar\"";
+  deserialize(text.data(), text.size(), tape);
+  REQUIRE(tape.root().str() == "scalar");
+}
+
+TEST_CASE("Tape large containers", "[core] [json]") {
+  String text = "[";
+  for(int i = 0; i < 20000; ++i) {
+    text += i ? ", " : "";
+    text += "{\"id\": " + std::to_string(i) + "}";
+  }
+  text += "]";
+
+  Tape tape;
+  deserialize(text.data(), text.size(), tape);
+  Tape::Array array = tape.root().array();
+  REQUIRE(array.size() == 20000);
+
+  Integer sum = 0;
+  for(Tape::Array::const_iterator it = array.begin(); it != array.end(); ++it) {
+    sum += it->object()["id"].integer();
+  }
+  REQUIRE(sum == 19999 * 20000 / 2);
+  REQUIRE(tape.root().toElement() == deserialize(text));
+}
+
+TEST_CASE("Tape numbers", "[core] [json]") {
+  Tape tape;
+  String text = "[-3, 18446744073709551615, 2.5, 9223372036854775807, 1e300]";
+  deserialize(text.data(), text.size(), tape);
+  Tape::Array numbers = tape.root().array();
+
+  REQUIRE(numbers[0].getNumberType() == Element::SIGNED_INTEGER);
+  REQUIRE(numbers[0].integer() == -3);
+  REQUIRE(numbers[0].number() == -3.0);
+  REQUIRE(numbers[1].getNumberType() == Element::UNSIGNED_INTEGER);
+  REQUIRE(numbers[1].unsignedInteger() == 18446744073709551615ULL);
+  REQUIRE(numbers[1].number() == 18446744073709551615.0);
+  REQUIRE(numbers[2].getNumberType() == Element::FLOATING_POINT);
+  REQUIRE(numbers[2].number() == 2.5);
+  REQUIRE(numbers[2].integer() == 2);
+  REQUIRE(numbers[2].unsignedInteger() == 2);
+  REQUIRE(numbers[3].integer() == 9223372036854775807LL);
+  REQUIRE(numbers[3].unsignedInteger() == 9223372036854775807ULL);
+
+  try {
+    numbers[0].unsignedInteger();
+    FAIL("Expected negative number to throw as unsigned.");
+  }
+  catch (TypeError &e) {
+  }
+
+  Tape::Value invalid[] = { numbers[1], numbers[4], tape.root(), Tape::Value() };
+  for(std::size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+    try {
+      invalid[i].integer();
+      FAIL("Expected value to throw as integer.");
+    }
+    catch (TypeError &e) {
+    }
+  }
+}
@@ -0,0 +1,71 @@
+#include "../catch.hpp"
+#include "json.hpp"
+
+using namespace xyz::json;
+
+namespace {
+  // Check that validate accepts input exactly when deserialize does, and reports the same error.
+  void requireSameResult(const String &text) {
+    String expected, actual;
+    int expectedLine = 0, actualLine = 0;
+    try {
+      deserialize(text);
+    }
+    catch (SyntaxError &e) {
+      expected = e.msg;
+      expectedLine = e.line;
+    }
+    try {
+      validate(text);
+    }
+    catch (SyntaxError &e) {
+      actual = e.msg;
+      actualLine = e.line;
+    }
+    INFO(text);
+    REQUIRE(actual == expected);
+    REQUIRE(actualLine == expectedLine);
+  }
+}
+
+TEST_CASE("Validate", "[core] [json]") {
+  const char *inputs[] = {
+    "{}", "[]", "null", "true", "-1.5e3", "\"\"", "  [1, 2] // comment",
+    "{\"a\": [1, {\"b\": null}], \"c\\u00e4\": \"\\ud83c\\udf89 \\\" \\\\ \\/\"}",
+    "", "[", "[1,]", "{\"a\" 1}", "{\"a\": 1,}", "[1 2]", "{} []", "tru", "nul", "01x", "1e400", "1.2.3",
+    "\"\\ud83c x\"", "\"\\q\"", "\"ok \xc4\"", "\"open", "[\n\"\n\"]", "[1] /", "{1: 2}", "[}", "{]"
+  };
+  for(std::size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+    requireSameResult(inputs[i]);
+  }
+
+  validate("[1, 2]");
+
+  try {
+    validate("{\n\"a\": [1,\n 2,, 3]}");
+    FAIL("Expected double comma to throw.");
+  }
+  catch (SyntaxError &e) {
+    REQUIRE(e.line == 3);
+    REQUIRE(e.chr == ',');
+  }
+}
+
+TEST_CASE("Validate large", "[core] [json]") {
+  // Large enough to use the stage-1 index, and repeated to reuse it.
+  String text = "[";
+  for(int i = 0; i < 5000; ++i) {
+    text += i ? ",\n" : "";
+    text += "{\"id\": " + std::to_string(i) + ", \"name\": \"record \\u0041\", \"ok\": true}";
+  }
+  text += "]";
+
+  requireSameResult(text);
+  requireSameResult(text.substr(0, text.size() - 1));
+  requireSameResult(text + " // trailing comment");
+
+  String broken = text;
+  broken[broken.size() / 2] = '}';
+  requireSameResult(broken);
+  requireSameResult("[1]");
+}
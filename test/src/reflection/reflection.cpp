@@ -70,6 +70,34 @@ namespace {
     BasicReflectable basic;
   };
 
+  class IntegerReflectable {
+  public:
+    void reflect(Reflection &refl) {
+      XYZ_REFLECT(refl, id);
+      XYZ_REFLECT(refl, hash);
+    }
+
+    long long id;
+    unsigned long long hash;
+  };
+
+  class NestedReflectable {
+  public:
+    NestedReflectable():count(0) {}
+
+    void reflect(Reflection &refl) {
+      XYZ_REFLECT(refl, count);
+      XYZ_REFLECT(refl, groups);
+      XYZ_REFLECT(refl, children);
+      XYZ_REFLECT(refl, composite);
+    }
+
+    int count;
+    std::map<String, std::vector<int> > groups;
+    std::vector<IntegerReflectable> children;
+    CompositeReflectable composite;
+  };
+
   class JsonReflectable {
   public:
     void reflect(Reflection &refl) {
@@ -328,6 +356,26 @@ TEST_CASE("Complex (recursive) reflection (sink)", "[core] [reflection]") {
   REQUIRE(actual["text"].str() == expected.basic.text);
 }
 
+TEST_CASE("Integer reflection (bidirectional)", "[core] [reflection]") {
+  // Given:
+  IntegerReflectable expected;
+  expected.id = -9007199254740993LL;
+  expected.hash = 18446744073709551557ULL;
+
+  // When:
+  ReflectionSink sink;
+  expected.reflect(sink);
+
+  IntegerReflectable actual;
+  ReflectionSource source(deserialize(serialize(sink.sink)));
+  actual.reflect(source);
+
+  // Then:
+  REQUIRE(serialize(sink.sink) == "{ \"id\": -9007199254740993, \"hash\": 18446744073709551557 }");
+  REQUIRE(actual.id == expected.id);
+  REQUIRE(actual.hash == expected.hash);
+}
+
 TEST_CASE("Json reflection (bidirectional)", "[core] [reflection]") {
   // Given:
   JsonReflectable expected;
@@ -354,3 +402,158 @@ TEST_CASE("Json reflection (bidirectional)", "[core] [reflection]") {
   // Then:
   REQUIRE(actual.element == expected.element);
 }
+
+TEST_CASE("Array reader reflection (source)", "[core] [reflection]") {
+  // Given:
+  String input = "{\"entities\": [{\"id\": 1, \"hash\": 18446744073709551615}, {\"id\": -2, \"hash\": 3}]}";
+  ArrayReader reader(input.data(), input.size(), "/entities");
+
+  // When:
+  std::vector<IntegerReflectable> actual;
+  Element element;
+  while(reader.next(element)) {
+    actual.push_back(IntegerReflectable());
+    ReflectionSource source(std::move(element));
+    actual.back().reflect(source);
+  }
+
+  // Then:
+  REQUIRE(actual.size() == 2);
+  REQUIRE(actual[0].id == 1);
+  REQUIRE(actual[0].hash == 18446744073709551615ULL);
+  REQUIRE(actual[1].id == -2);
+  REQUIRE(actual[1].hash == 3);
+}
+
+TEST_CASE("Lazy reflection (source)", "[core] [reflection]") {
+  SECTION("Primitives") {
+    // Given:
+    String input = "{\"text\": \"esc\\\"aped\", \"unknown\": [1, {\"a\": null}], \"integer\": -12958,"
+                   " \"nonsigned\": 7612958, \"boolean\": true, \"floating\": 0.5, \"floatinger\": 475.25}";
+
+    // When:
+    BasicReflectable actual;
+    xyz::core::deserialize(input, actual);
+
+    // Then:
+    REQUIRE(actual.integer == -12958);
+    REQUIRE(actual.nonsigned == 7612958);
+    REQUIRE(actual.boolean == true);
+    REQUIRE(actual.floating == 0.5f);
+    REQUIRE(actual.floatinger == 475.25);
+    REQUIRE(actual.text == "esc\"aped");
+  }
+
+  SECTION("Nested") {
+    // Given:
+    String input = "{\"basic\": {\"integer\": 3, \"text\": \"in\\u0041\"},"
+                   " \"composite\": {\"list\": [1.5, 2], \"map\": {\"k\\u0065y\": \"value\"}, \"vector\": [4, 5, 6]},"
+                   " \"property\": {\"value\": 7}, \"ids\": {\"id\": -1, \"hash\": 18446744073709551615},"
+                   " \"json\": {\"element\": {\"any\": [true]}}}";
+
+    // When:
+    ComplexReflectable complex;
+    CompositeReflectable composite;
+    PropertyReflectable property;
+    IntegerReflectable ids;
+    JsonReflectable json;
+    LazyDocument document;
+    deserialize(input.data(), input.size(), document);
+    LazyDocument::Object root = document.root().object();
+    xyz::core::LazyReflectionSource source(document.root());
+    complex.reflect(source);
+    xyz::core::Reflector<CompositeReflectable>(composite).writeLazy(root["composite"]);
+    xyz::core::Reflector<PropertyReflectable>(property).writeLazy(root["property"]);
+    xyz::core::Reflector<IntegerReflectable>(ids).writeLazy(root["ids"]);
+    xyz::core::Reflector<JsonReflectable>(json).writeLazy(root["json"]);
+
+    // Then:
+    REQUIRE(complex.basic.integer == 3);
+    REQUIRE(complex.basic.text == "inA");
+    REQUIRE(composite.map.size() == 1);
+    REQUIRE(composite.map["key"] == "value");
+    REQUIRE(composite.vector == std::vector<int>({4, 5, 6}));
+    REQUIRE(composite.list == std::list<float>({1.5f, 2.0f}));
+    REQUIRE(property.value == 7);
+    REQUIRE(ids.id == -1);
+    REQUIRE(ids.hash == 18446744073709551615ULL);
+    REQUIRE(json.element == deserialize("{\"any\": [true]}"));
+  }
+
+  SECTION("Errors") {
+    IntegerReflectable actual;
+    String inputs[] = { "[1, 2]", "{\"id\": \"1\"}", "{\"id\": 1x}", "{\"id\": [1}" };
+    for(int i = 0; i < 4; ++i) {
+      try {
+        xyz::core::deserialize(inputs[i], actual);
+        FAIL("Expected input to throw: " << inputs[i]);
+      }
+      catch (TypeError &e) {
+        REQUIRE(i < 2);
+      }
+      catch (SyntaxError &e) {
+        REQUIRE(i >= 2);
+      }
+    }
+  }
+}
+
+TEST_CASE("Lazy reflection (differential)", "[core] [reflection]") {
+  // Loading straight from the input must give the same result, or the same kind of error, as going
+  // through an element tree.
+  const char *inputs[] = {
+    "{\"count\": 1, \"groups\": {\"a\": [1, 2], \"b\": []}, \"children\": [{\"id\": -1, \"hash\": 2}],"
+    " \"composite\": {\"map\": {\"k\": \"v\"}, \"vector\": [3], \"list\": [0.5]}}",
+    "{\"count\": 2, \"groups\": {\"a\": [1, 2,],}, \"children\": [{\"id\": 1, \"hash\": 2,},],}",
+    "{\"extra\": {\"deep\": [1, {\"x\": null}]}, \"children\": [{\"hash\": 5, \"id\": 4, \"more\": \"\\u0041\"}],"
+    " \"unused\": [true, false], \"count\": 3}",
+    "{\"composite\": null, \"groups\": null}",
+    "{\"count\": 1, \"extra\": [1 2]}",
+    "{\"count\": 1, \"extra\": tru}",
+    "{\"count\": 1, \"extra\": \"\\x\"}",
+    "{\"count\": 1,, \"groups\": {}}",
+    "{\"count\": \"1\"}",
+    "{\"groups\": {\"a\": 1}}",
+    "[{\"count\": 1}]",
+    "{\"count\": 1, \"groups\": {\"a\": [1], \"a\": [2]}, \"count\": 2, \"children\": [{\"id\": 1, \"hash\": 4, \"id\": 3}]}",
+    "{\"k0\": 0, \"k1\": 1, \"k2\": 2, \"k3\": 3, \"k4\": 4, \"k5\": 5, \"k6\": 6, \"k7\": 7, \"count\": 1,"
+    " \"k8\": 8, \"k9\": 9, \"k10\": 10, \"k11\": 11, \"k12\": 12, \"k13\": 13, \"k14\": 14, \"k15\": 15,"
+    " \"k16\": 16, \"count\": 2, \"k17\": 17, \"k16\": 0, \"count\": 3}",
+  };
+
+  for(std::size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+    String input = inputs[i];
+    INFO(input);
+
+    NestedReflectable expected, actual;
+    String expectedError, actualError;
+    try {
+      ReflectionSource source(deserialize(input));
+      expected.reflect(source);
+    }
+    catch (const SyntaxError &e) {
+      expectedError = "SyntaxError";
+    }
+    catch (const TypeError &e) {
+      expectedError = "TypeError";
+    }
+
+    try {
+      xyz::core::deserialize(input, actual);
+    }
+    catch (const SyntaxError &e) {
+      actualError = "SyntaxError";
+    }
+    catch (const TypeError &e) {
+      actualError = "TypeError";
+    }
+
+    REQUIRE(actualError == expectedError);
+    if(expectedError.empty()) {
+      ReflectionSink expectedSink, actualSink;
+      expected.reflect(expectedSink);
+      actual.reflect(actualSink);
+      REQUIRE(actualSink.sink == expectedSink.sink);
+    }
+  }
+}